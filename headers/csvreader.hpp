@@ -33,7 +33,7 @@
 
 namespace csvreader
 {
-std::vector<Vehicle> load_vehicles();
+std::vector<Vehicle> load_vehicles(Network const & network);
 std::vector<Request> load_requests(Network const & network);
 }
 
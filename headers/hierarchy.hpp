@@ -0,0 +1,71 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef HIERARCHY_HPP
+#define HIERARCHY_HPP
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/* Contraction hierarchy over the edge graph.  Nodes are contracted one at a time, adding shortcuts that keep
+   shortest paths intact, and a query is a bidirectional Dijkstra that only climbs to higher ranked nodes.
+   Memory grows with the number of edges and shortcuts rather than with the square of the node count. */
+class ContractionHierarchy
+{
+public:
+    /* Edges are given as (target, weight) lists per origin node. */
+    ContractionHierarchy(std::vector<std::vector<std::pair<int,int>>> const & edges);
+    
+    static int const UNREACHABLE = 100000000;   // Reported time between disconnected nodes.
+    
+    /* Shortest travel time, served from a small per-thread cache of recent queries when possible. */
+    int get_time(int origin, int destination) const;
+    
+    /* Node sequence of a shortest path, including both ends. */
+    std::vector<int> get_path(int origin, int destination) const;
+    
+    int get_node_count() const;
+    int get_edge_count() const;  // Upward edges, including shortcuts.
+    
+private:
+    struct Arc
+    {
+        int target;
+        int weight;
+    };
+    
+    int query(int origin, int destination, std::vector<int>* path) const;
+    void unpack(int from, int to, std::vector<int> & path) const;
+    
+    int node_count;
+    std::vector<int> forward_first;     // Upward arcs out of each node, as index ranges into forward_arcs.
+    std::vector<Arc> forward_arcs;
+    std::vector<int> backward_first;    // Upward arcs into each node, reversed, in backward_arcs.
+    std::vector<Arc> backward_arcs;
+    std::unordered_map<uint64_t,int> middles;  // Contracted node bridged by each shortcut.
+};
+
+#endif /* HIERARCHY_HPP */
@@ -0,0 +1,55 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef LANDMARKS_HPP
+#define LANDMARKS_HPP
+
+#include "threads.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/* ALT lower bounds.  Travel times to and from a few landmark nodes, spread out by farthest point selection,
+   bound the time between any two nodes through the triangle inequality without a shortest path query.
+   Memory is two int32_t per node and landmark. */
+class Landmarks
+{
+public:
+    /* Edges are given as (target, weight) lists per origin node, as for ContractionHierarchy. */
+    Landmarks(std::vector<std::vector<std::pair<int,int>>> const & edges, int count, Threads & threads);
+    
+    /* Never more than the shortest travel time from origin to destination. */
+    int get_lower_bound(int origin, int destination) const;
+    
+    int get_count() const;
+    
+private:
+    int count;
+    std::vector<int32_t> from_landmark;  // Time from each landmark to the node, count cells per node.
+    std::vector<int32_t> to_landmark;    // Time from the node to each landmark, count cells per node.
+};
+
+#endif /* LANDMARKS_HPP */
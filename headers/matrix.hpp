@@ -0,0 +1,105 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef MATRIX_HPP
+#define MATRIX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Header of the binary matrix format.  The header is followed directly by rows * cols cells, stored
+   row-major in native byte order.  Binary files are memory-mapped read-only, so concurrent runs on the
+   same machine share one page-cache copy of the matrix. */
+struct MatrixHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t cell_bytes;
+    uint64_t rows;
+    uint64_t cols;
+};
+
+/* Dense row-major matrix in one contiguous block, either owned or memory-mapped from a binary file.  The
+   cell type sets the memory footprint; uint16_t holds travel times of up to 18 hours in half the space
+   of int32_t.  Instantiated for uint8_t, uint16_t and int32_t in matrix.cpp. */
+template <typename T>
+class Matrix
+{
+public:
+    Matrix();
+    ~Matrix();
+    
+    /* Load from either a comma separated text file or a binary file, detected by the magic bytes.  Binary
+       files with a matching cell width are mapped, others are converted.  Throws if a value does not fit. */
+    void load(std::string const & filename);
+    void save(std::string const & filename) const;
+    
+    /* Replace the contents with owned storage of the given shape, every cell set to value. */
+    void allocate(int rows, int cols, T value);
+    void set(int row, int col, T value)
+    {
+        storage[std::size_t(row) * cols + col] = value;
+    }
+    
+    /* View cells owned elsewhere, such as a shared memory segment that outlives the matrix. */
+    void attach(T const* cells, int rows, int cols);
+    
+    /* Renumber a square matrix so that cell (i, j) becomes the old cell (order[i], order[j]).  A mapped matrix
+       is copied into owned storage. */
+    void permute(std::vector<int> const & order);
+    
+    T get(int row, int col) const
+    {
+        return data[std::size_t(row) * cols + col];
+    }
+    T const* get_row(int row) const
+    {
+        return data + std::size_t(row) * cols;
+    }
+    int get_rows() const;
+    int get_cols() const;
+    bool is_mapped() const;
+    
+private:
+    Matrix(Matrix const &);
+    Matrix & operator=(Matrix const &);
+    
+    void load_csv(std::string const & filename);
+    void map_binary(std::string const & filename);
+    void release();
+    
+    std::vector<T> storage;
+    void* mapping;
+    std::size_t mapping_size;
+    T const* data;
+    int rows;
+    int cols;
+};
+
+/* True if the file begins with the binary matrix magic bytes. */
+bool is_binary_matrix(std::string const & filename);
+
+#endif /* MATRIX_HPP */
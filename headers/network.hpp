@@ -25,13 +25,34 @@
 #ifndef NETWORK_HPP
 #define NETWORK_HPP
 
+#include "hierarchy.hpp"
+#include "landmarks.hpp"
+#include "matrix.hpp"
+#include "sharedmemory.hpp"
+#include "threads.hpp"
 #include "vehicle.hpp"
 
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
 #include <vector>
 
 typedef int vertex_t;
 typedef double weight_t;
 
+/* Cell type of the travel time and distance matrices.  uint16_t seconds cover city-scale trips (up to about
+   18 hours) at half the memory of int32_t, so a 32k-node map fits in 2 GB.  Use int32_t for larger values. */
+typedef uint16_t time_cell_t;
+
+/* Cell type of the successor table, which holds node ids.  The largest value marks "no path". */
+typedef uint16_t node_cell_t;
+
+/* Time profiles store each cell as a multiple of 1/64 of the base travel time, so an hourly profile costs
+   one byte per pair and factors from 0 to about 4 can be represented. */
+typedef uint8_t profile_cell_t;
+int const PROFILE_SHIFT = 6;
+
 
 struct neighbor
 {
@@ -40,21 +61,125 @@ struct neighbor
     neighbor(vertex_t arc_target, weight_t arc_weight)
         : target(arc_target), weight(arc_weight) {}
 };
+/* Planar position in meters, projected from latitude and longitude. */
+struct Point
+{
+    double x;
+    double y;
+};
  
 class Network
 {
  public:
-    Network();
+    Network(Threads & threads);
+    
+    /* Travel time between two real nodes.  The nodes are only checked in builds without NDEBUG; dwelling and
+       waiting at a stop are not legs of the network, see get_dwell_time. */
     int get_time(int node_one, int node_two) const;
+    int get_time(int node_one, int node_two, int departure) const;  // Uses the profile of the departure time.
+
+    int get_dwell_time(bool is_pickup) const;       // Time spent serving one pickup or alighting at a stop.
+    
+    /* Never more than the travel time of a route from node_one to node_two, at any departure time.  Exact
+       with the matrix backend, and ALT landmark bounds with the hierarchy, so it is cheap either way. */
+    int get_lower_bound(int node_one, int node_two) const;
+    bool is_bound_exact() const;                    // True if get_lower_bound is get_time itself.
+    
+    /* Deadline checks past the next stop, where the departure is not known yet: get_time without time
+       profiles, and get_lower_bound with them, as a later departure may take a faster profile. */
+    int get_reach_time(int node_one, int node_two) const;
+    bool has_time_profiles() const;                 // Profile lookups round per leg, so routes may beat sums of bounds.
+    
+    /* Travel times from every source into target.  With TRANSPOSED_MATRIX this reads one contiguous row
+       instead of a cell in each source's row. */
+    void get_times_to(int target, std::vector<int> const & sources, std::vector<int> & times) const;
     std::vector<int> dijkstra(int source, int destination) const;
+    std::vector<int> get_path(int origin, int destination) const;  // Uses the successor table if built.
     int get_distance(int node_one, int node_two) const;
     int get_vehicle_time(Vehicle const & v, int node) const;
     int get_vehicle_distance(Vehicle const & v, int node) const;
     int get_vehicle_offset(Vehicle const & v) const;
+    bool has_positions() const;                     // True if NODES_FILE placed every node.
+    Point get_position(int node) const;
+    double get_reach(int seconds) const;            // Farthest straight line distance covered in that time.
+    
+    /* True unless a sample of travel times, checked at load against Dijkstra searches over the edges, has one
+       faster than any route along the edges.  get_reach and get_reverse_reach only hold when it is true. */
+    bool is_edge_bounded() const;
+    int get_node_count() const;
+    
+    /* Nodes are renumbered inside the simulator with NODE_ORDER.  External ids are those of the input files,
+       less one; everything read or written goes through these. */
+    int to_internal(int node) const;
+    int to_external(int node) const;
+    
+    /* List every node with a route to destination of at most limit seconds, with its travel time, found by a
+       Dijkstra search backwards over the edges.  Only available with RV_CANDIDATES REACH. */
+    void get_reverse_reach(int destination, int limit, std::vector<std::pair<int,int>> & reached) const;
 private:
-    std::vector<std::vector<int>> time_matrix;
-    std::vector<std::vector<int>> distance_matrix;
+    void check_nodes(int node_one, int node_two) const;
+    void renumber(std::vector<int> const & order);
+    void load_distances() const;
+    void publish_shared();
+    void adopt_shared();
+    
+    std::unique_ptr<SharedSegment> shared_segment;  // Declared first so the matrices viewing it go first.
+    std::vector<int> internal_of;                   // Empty when nodes keep their file order.
+    std::vector<int> external_of;
+    Matrix<time_cell_t> time_matrix;
+    Matrix<time_cell_t> transposed_matrix;          // Row is the destination, built with TRANSPOSED_MATRIX.
+    mutable Matrix<time_cell_t> distance_matrix;    // Loaded lazily by get_distance.
+    mutable std::once_flag distance_loaded;
     std::vector<std::vector<neighbor>> adjacency_list;
+    std::vector<std::vector<neighbor>> reverse_adjacency_list;
+    std::vector<Point> positions;
+    double reach_speed;                             // Largest edge length per second of travel time.
+    double reach_margin;                            // Total length of edges that take no time.
+    bool edge_bounded;
+    Matrix<profile_cell_t> profile_factors;         // TIME_PROFILES blocks of rows, one per time profile.
+    int profile_count;
+    int profile_period;                             // TIME_PROFILE_PERIOD, kept here for the inline lookup.
+    int profile_floor;                              // Smallest profile factor, for lower bounds.
+    Matrix<node_cell_t> successor_matrix;           // Row is the destination, column the node to leave.
+    std::unique_ptr<ContractionHierarchy> hierarchy;  // Replaces time_matrix with NETWORK_BACKEND HIERARCHY.
+    std::unique_ptr<Landmarks> landmarks;           // Lower bounds alongside the hierarchy.
 };
+
+inline int Network::get_time(int node_one, int node_two) const
+{
+#ifndef NDEBUG
+    check_nodes(node_one, node_two);
+#endif
+    if (hierarchy)
+        return hierarchy->get_time(node_one, node_two);
+    return time_matrix.get(node_one, node_two);
+}
+
+inline int Network::get_time(int node_one, int node_two, int departure) const
+{
+    if (!profile_count)
+        return get_time(node_one, node_two);
+#ifndef NDEBUG
+    check_nodes(node_one, node_two);
+#endif
+    int row = departure / profile_period % profile_count * time_matrix.get_rows() + node_one;
+    int base = time_matrix.get(node_one, node_two);
+    return (base * profile_factors.get(row, node_two) + (1 << (PROFILE_SHIFT - 1))) >> PROFILE_SHIFT;
+}
+
+inline int Network::get_lower_bound(int node_one, int node_two) const
+{
+    if (landmarks)
+        return landmarks->get_lower_bound(node_one, node_two);
+    if (hierarchy)
+        return 0;
+    int base = time_matrix.get(node_one, node_two);
+    return (profile_count ? (base * profile_floor) >> PROFILE_SHIFT : base);
+}
+
+inline int Network::get_reach_time(int node_one, int node_two) const
+{
+    return (profile_count ? get_lower_bound(node_one, node_two) : get_time(node_one, node_two));
+}
  
 #endif /* NETWORK_HPP */
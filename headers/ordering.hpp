@@ -0,0 +1,43 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef ORDERING_HPP
+#define ORDERING_HPP
+
+#include "network.hpp"
+
+#include <vector>
+
+/* Node orders that put nearby intersections next to each other, so neighbouring rows and columns of the
+   travel time matrix share cache lines and pages.  Entry i of an order is the input node to number i. */
+namespace ordering
+{
+/* Order along a Hilbert curve through the node positions. */
+std::vector<int> hilbert(std::vector<Point> const & positions);
+
+/* Reverse Cuthill-McKee order of the edge graph, ignoring edge directions. */
+std::vector<int> reverse_cuthill_mckee(std::vector<std::vector<neighbor>> const & adjacency_list);
+}
+
+#endif /* ORDERING_HPP */
@@ -0,0 +1,65 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef ROUTECACHE_HPP
+#define ROUTECACHE_HPP
+
+#include "request.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/* Routes found during one epoch, shared by all threads.  Keys are built by the caller and must hold
+   everything the route depends on, so a hit is exactly what a new search would return.  The map is split
+   into shards, each behind its own lock, so threads rarely wait on each other. */
+class RouteCache
+{
+public:
+    typedef std::vector<uintptr_t> Key;
+    typedef std::pair<int,std::vector<NodeStop>> Route;
+    
+    bool find(Key const & key, Route & route);
+    void insert(Key const & key, Route const & route);
+    void clear();
+    
+private:
+    struct KeyHash
+    {
+        size_t operator()(Key const & key) const;
+    };
+    struct Shard
+    {
+        std::mutex lock;
+        std::unordered_map<Key,Route,KeyHash> routes;
+    };
+    
+    static int const SHARDS = 64;
+    Shard shards[SHARDS];
+};
+
+#endif /* ROUTECACHE_HPP */
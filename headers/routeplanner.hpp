@@ -40,11 +40,31 @@ enum Purpose {STANDARD, REBALANCING, MEMORY};
 namespace routeplanner
 {
 
+/* Best route for the vehicle serving requests.  With ROUTE_CACHE, routes with no new requests and MEMORY
+   routes are kept until clear_cache, so each is searched once per epoch. */
 std::pair<int,std::vector<NodeStop>> travel(Vehicle const & vehicle, std::vector<Request*> const & requests, 
         Purpose trigger, Network const & network, int time);
+void clear_cache();  // Call at the start of each epoch.
+
+/* Whether travel() would find a route, stopping at the first one found and without building it. */
+bool feasible(Vehicle const & vehicle, std::vector<Request*> const & requests, Network const & network, int time);
 std::pair<int,std::vector<NodeStop>> time_travel(Vehicle const & vehicle, std::vector<Request*> const & requests,
         Purpose trigger, Network const & network, int time, std::chrono::steady_clock::time_point t);
 
+/* time_travel warm started from incumbent, a stop order serving the same requests, such as an insertion into
+   a parent trip's order.  The search only looks for routes at least as fast, and gives the incumbent back if
+   it runs out of time first.  CTSP FIX_ONBOARD and FIX_PREFIX restrict the order, so they ignore incumbent. */
+std::pair<int,std::vector<NodeStop>> time_travel(Vehicle const & vehicle, std::vector<Request*> const & requests,
+        Purpose trigger, Network const & network, int time, std::chrono::steady_clock::time_point t,
+        std::vector<NodeStop> const & incumbent);
+bool takes_incumbent();  // Whether CTSP lets time_travel use incumbent at all, so it is worth computing.
+
+/* Adds request to a feasible stop order of the vehicle, trying every pickup and dropoff position, and keeps
+   the fastest.  A quick upper bound on travel() with the request added.  A cost of -1 means no insertion
+   works, not that no route exists. */
+std::pair<int,std::vector<NodeStop>> insertion(Vehicle const & vehicle, std::vector<NodeStop> const & order,
+        Request* request, Network const & network, int time);
+
 }
 
 #endif /* ROUTEPLANNER_HPP */
@@ -12,34 +12,55 @@
 #define PRUNING_RR_K 0 //10    // Heuristic that only connects requests with nearest k requests.
 
 enum Algorithm {ILP_FULL};
-enum Ctsp {FULL, FIX_ONBOARD, FIX_PREFIX, MEGA_TSP};
+enum Ctsp {FULL, FIX_ONBOARD, FIX_PREFIX, MEGA_TSP, FULL_DP};
 enum CtspObjective {CTSP_VMT, CTSP_TOTALDROPOFFTIME, CTSP_TOTALWAITING};
 enum AssignmentObjective {AO_SERVICERATE, AO_RMT};
+enum NetworkBackend {NB_MATRIX, NB_HIERARCHY};
+enum RvCandidates {RV_SCAN, RV_GRID, RV_REACH};
+enum NodeOrder {NO_FILE, NO_HILBERT, NO_RCM};
 
 #include<string>
 extern Algorithm ALGORITHM;
 extern double alpha;
 extern AssignmentObjective ASSIGNMENT_OBJECTIVE;
+extern bool BUILD_MATRIX;                       // Compute TIMEFILE from EDGECOST_FILE and cache it.
 extern int CARSIZE;
 extern Ctsp CTSP;
 extern CtspObjective CTSP_OBJECTIVE;
 extern std::string DATAROOT;
+extern std::string DISTANCEFILE;                 // Empty to use travel times as distances.
 extern int DWELL_ALIGHT;
 extern int DWELL_PICKUP;
 extern std::string EDGECOST_FILE;
 extern int FINAL_TIME;
 extern int INITIAL_TIME;
+extern bool INSERTION_HEURISTIC;                // Price RTV trips by insertion before the exact search.
 extern int INTERVAL;
+extern int LANDMARKS;                           // Landmarks for lower bounds with the HIERARCHY backend.
 extern bool LAST_MINUTE_SERVICE;                // Feature does not work with dwell times.
 extern int MAX_DETOUR;
 extern int MAX_WAITING;
+extern int MEGA_TSP_ITERATIONS;                 // LNS moves per route with CTSP MEGA_TSP.
+extern NetworkBackend NETWORK_BACKEND;
+extern NodeOrder NODE_ORDER;                    // Renumbering of the nodes inside the simulator.
+extern std::string NODES_FILE;                  // Node coordinates for the vehicle grid and HILBERT order.
 extern std::string REQUEST_DATA_FILE;
 extern std::string RESULTS_DIRECTORY;
+extern bool ROUTE_CACHE;                        // Search each vehicle and request set once per epoch.
 extern int RH;
 extern int RTV_TIMELIMIT;
+extern RvCandidates RV_CANDIDATES;              // How make_rvgraph finds the vehicles worth checking.
+extern std::string SHARED_NETWORK;              // Name of a shared memory segment holding the matrices.
+extern std::string SUCCESSORFILE;
+extern bool SUCCESSOR_TABLE;                    // Precompute next hops for the simulator's paths.
 extern std::string TIMEFILE;
+extern bool TRANSPOSED_MATRIX;                  // Keep a column-major copy of the travel times as well.
+extern int TIME_PROFILE_PERIOD;                 // Seconds covered by each time profile.
+extern std::string TIME_PROFILE_PREFIX;
+extern int TIME_PROFILES;                       // Number of time-of-day travel time matrices, 0 for none.
 extern std::string VEHICLE_DATA_FILE;
 extern int VEHICLE_LIMIT;
+extern bool WARM_START;                         // Bound RTV trip searches by an insertion into the parent trip.
 
 void initialize(int argc, char** argv);
 
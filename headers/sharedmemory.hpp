@@ -0,0 +1,71 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SHAREDMEMORY_HPP
+#define SHAREDMEMORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Shape of one block of a shared segment.  Blocks hold matrices or lists, so rows and cols describe them. */
+struct SharedBlock
+{
+    uint64_t offset;
+    uint64_t bytes;
+    int32_t rows;
+    int32_t cols;
+};
+
+/* A named POSIX shared memory segment that the first process fills with read-only blocks for the others on
+   the same machine.  The segment outlives its processes, so later runs attach instantly; delete it with
+   "rm /dev/shm/<name>" when the inputs change.  Blocks are aligned to 2 MB and advised as huge pages. */
+class SharedSegment
+{
+public:
+    SharedSegment();
+    ~SharedSegment();
+    
+    /* Map the named segment if it exists, waiting while its publisher is still filling it.  Returns false
+       if there is none.  Throws if it was built from different inputs, given by signature. */
+    bool attach(std::string const & name, std::string const & signature);
+    
+    /* Create the named segment with the given blocks, which the caller then fills and publishes.  Returns
+       false if another process created it first. */
+    bool create(std::string const & name, std::string const & signature, std::vector<SharedBlock> blocks);
+    void publish();
+    
+    SharedBlock get_block(int index) const;
+    void* get_data(int index) const;
+    
+private:
+    SharedSegment(SharedSegment const &);
+    SharedSegment & operator=(SharedSegment const &);
+    
+    void* region;
+    std::size_t size;
+};
+
+#endif /* SHAREDMEMORY_HPP */
@@ -0,0 +1,48 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SHORTESTPATH_HPP
+#define SHORTESTPATH_HPP
+
+#include "matrix.hpp"
+#include "network.hpp"
+#include "threads.hpp"
+
+#include <vector>
+
+namespace shortestpath
+{
+/* All-pairs travel times over the edge graph, one Dijkstra per source spread over the thread pool.  Row is
+   the origin.  Unreachable pairs get the largest cell value, and a path that long or longer throws. */
+void build_times(std::vector<std::vector<neighbor>> const & adjacency_list, Matrix<time_cell_t> & times,
+        Threads & threads);
+
+/* Next hop table, taking the steps of Network::dijkstra, so paths follow times whether or not it was built
+   from these edges.  Row is the destination, column the node to leave; the largest cell value marks no
+   step, either no path or one that starts on edges taking no time. */
+void build_successors(std::vector<std::vector<neighbor>> const & adjacency_list,
+        Matrix<time_cell_t> const & times, Matrix<node_cell_t> & successors, Threads & threads);
+}
+
+#endif /* SHORTESTPATH_HPP */
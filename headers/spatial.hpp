@@ -0,0 +1,58 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SPATIAL_HPP
+#define SPATIAL_HPP
+
+#include "network.hpp"
+#include "vehicle.hpp"
+
+#include <vector>
+
+/* Vehicles bucketed by the square grid cell around their next node, so a request only looks at vehicles
+   that could reach it in time.  Built once per epoch and then shared read-only by the threads. */
+class VehicleGrid
+{
+public:
+    VehicleGrid(Network const & network, std::vector<Vehicle*> const & vehicles);
+    
+    /* Append the indices of vehicles whose next node may be within the given travel time of node, in
+       increasing order.  A superset of the vehicles that can make it; callers still check the times. */
+    void query(int node, int seconds, std::vector<int> & out) const;
+    
+private:
+    int cell_of(double value, double low, int cells) const;
+    
+    Network const & network;
+    std::vector<Point> locations;       // Position of each vehicle's next node.
+    double cell_size;
+    double min_x;
+    double min_y;
+    int cols;
+    int rows;
+    std::vector<int> cell_start;        // Vehicles of cell c are members[cell_start[c]] to members[cell_start[c + 1]].
+    std::vector<int> members;
+};
+
+#endif /* SPATIAL_HPP */
@@ -32,6 +32,11 @@
 
 enum States {Idle, Rebalancing, EnRoute, InUse, Boarding};
 
+/* Values of prev_node while a vehicle stands at its node instead of driving towards it. */
+int const PREV_PICKUP_DWELL = -10;
+int const PREV_ALIGHT_DWELL = -20;
+int const PREV_WAITING = -30;
+
 class Vehicle
 {
 public:
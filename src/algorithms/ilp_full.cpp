@@ -27,11 +27,13 @@
 #include "generator.hpp"
 #include "routeplanner.hpp"
 #include "settings.hpp"
+#include "spatial.hpp"
 
 #include <algorithm>
 #include <cmath>
 #include <mutex> // <-- Guilty party.  Secretly includes "chrono"
 #include <fstream>
+#include <memory>
 #include <set>
 #include <sstream>
 #include <stdexcept>
@@ -70,6 +72,7 @@ void make_rtvgraph(void* rtv_data)
     auto trip_list = data->trip_list;
     auto network = data->network;
     auto vehicles = data->vehicles;
+    bool warm_start = (WARM_START && !INSERTION_HEURISTIC && routeplanner::takes_incumbent());
     
     for (auto i = start; i < end; i ++)
     {
@@ -106,7 +109,14 @@ void make_rtvgraph(void* rtv_data)
         for (auto r : initial_pairing)
         {
             vector<Request*> requests {r};
-            pair<int,vector<NodeStop>> path = routeplanner::time_travel(*v, requests, STANDARD, *network, time, start_time);
+            // An insertion into the vehicle's current order prices the trip, or warm starts the exact search.
+            pair<int,vector<NodeStop>> path (-1, vector<NodeStop>());
+            if (INSERTION_HEURISTIC || warm_start)
+                path = routeplanner::insertion(*v, round[0][0].order_record, r, *network, time);
+            if (path.first < 0)
+                path = routeplanner::time_travel(*v, requests, STANDARD, *network, time, start_time);
+            else if (!INSERTION_HEURISTIC)
+                path = routeplanner::time_travel(*v, requests, STANDARD, *network, time, start_time, path.second);
             if (path.first >= 0)
             {
                 Trip trip {};
@@ -229,8 +239,18 @@ void make_rtvgraph(void* rtv_data)
                         auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time).count();
                         preokay = (duration <= RTV_TIMELIMIT);
                     }
-                    pair<int,vector<NodeStop>> path = routeplanner::time_travel(
-                            *v, request_vector, STANDARD, *network, time, start_time);
+                    // With INSERTION_HEURISTIC, try adding the new request to the order of the left trip first.
+                    // With WARM_START, that insertion is the first route of the exact search.
+                    pair<int,vector<NodeStop>> path (-1, vector<NodeStop>());
+                    if (INSERTION_HEURISTIC || warm_start)
+                        for (auto r : right)
+                            if (!left.count(r))
+                                path = routeplanner::insertion(*v, round[k-1][first].order_record, r, *network, time);
+                    if (path.first < 0)
+                        path = routeplanner::time_travel(*v, request_vector, STANDARD, *network, time, start_time);
+                    else if (!INSERTION_HEURISTIC)
+                        path = routeplanner::time_travel(*v, request_vector, STANDARD, *network, time, start_time,
+                                path.second);
                     if (path.first < 0)
                         continue;
                     
@@ -294,6 +314,8 @@ struct rv_thread_data
     Network const* network;
     vector<Request*> const* requests;
     vector<Vehicle*> const* vehicles;
+    VehicleGrid const* grid;                    // Null unless RV_CANDIDATES is GRID.
+    vector<vector<int>> const* vehicles_at;     // Vehicle indices by next node, null unless REACH.
 };
 
 
@@ -309,7 +331,11 @@ void make_rvgraph(void* rv_data)
     auto network = data->network;
     auto requests = data->requests;
     auto vehicles = data->vehicles;
+    auto grid = data->grid;
+    auto vehicles_at = data->vehicles_at;
     
+    vector<int> candidates, sources, times;
+    vector<pair<int,int>> reached;
     for (int i = start; i < end; i++)
     {
         Request* r = (*requests)[i];
@@ -318,11 +344,52 @@ void make_rvgraph(void* rv_data)
         double buffer = 0;
         vector<Vehicle*> compatible_vehicles;
 
+        // Candidate vehicles in fleet order, so ties in nearest_vs match the full scan.
+        candidates.clear();
+        if (grid)  // Only vehicles within reach.
+            grid->query(origin, r->latest_boarding - time, candidates);
+        else if (vehicles_at)  // Vehicles parked on nodes a backwards search reaches in time.
+        {
+            int limit = r->latest_boarding - time;
+            reached.clear();
+            network->get_reverse_reach(origin, limit, reached);
+            for (auto & x : reached)
+                for (auto c : (*vehicles_at)[x.first])
+                    if (x.second + (*vehicles)[c]->offset <= limit)
+                        candidates.push_back(c);
+            sort(candidates.begin(), candidates.end());
+        }
+        else
+            for (auto c = 0; c < vehicles->size(); c++)
+                candidates.push_back(c);
+        
+        // Drop vehicles that cannot make it by the lower bound first, if it is cheaper than the travel time.
+        if (!network->is_bound_exact())
+        {
+            auto kept = candidates.begin();
+            for (auto c : candidates)
+            {
+                Vehicle* v = (*vehicles)[c];
+                if (time + v->offset + network->get_lower_bound(v->node, origin) <= r->latest_boarding)
+                    *kept++ = c;
+            }
+            candidates.erase(kept, candidates.end());
+        }
+        
+        // Times into the origin in one batch, which reads a single row of the transposed matrix if built.  Time
+        // profiles can beat these base times, so there only the lower bounds above rule vehicles out.
+        sources.clear();
+        for (auto c : candidates)
+            sources.push_back((*vehicles)[c]->node);
+        network->get_times_to(origin, sources, times);
+        
         multimap<int,Vehicle*> nearest_vs;
-        for (Vehicle* v : *vehicles)
+        bool base_bounds = !network->has_time_profiles();
+        for (auto k = 0; k < candidates.size(); k++)
         {
-            double min_wait = network->get_vehicle_time(*v, origin) - buffer;
-            if (time + min_wait > r->latest_boarding) continue;
+            Vehicle* v = (*vehicles)[candidates[k]];
+            double min_wait = v->offset + times[k] - buffer;
+            if (base_bounds && time + min_wait > r->latest_boarding) continue;
             nearest_vs.insert(make_pair(min_wait, v));
         }
         
@@ -330,8 +397,7 @@ void make_rvgraph(void* rv_data)
         for (auto &x : nearest_vs)
         {
             Vehicle* v = x.second;
-            pair<int,vector<NodeStop>> raw_path = routeplanner::travel(*v, requests, STANDARD, *network, time);
-            if (raw_path.first >=0 )
+            if (routeplanner::feasible(*v, requests, *network, time))
             {
                 compatible_vehicles.push_back(v);
                 if (PRUNING_RV_K > 0 && ++count >= PRUNING_RV_K) break;
@@ -407,15 +473,16 @@ void make_rrgraph(void* rr_data)
             // Heuristic to prune the requests without calling the travel function.
             int r2_origin = r2->origin;
             double buffer = 0;
-            double min_wait = network->get_time(start_node, r2_origin) - buffer;
+            double min_wait = network->get_lower_bound(start_node, r2_origin) - buffer;
             if (min_wait + max(time, r1->entry_time) > r2->latest_boarding)
                 continue;
+            if (!network->has_time_profiles() && time + min_wait +
+                    network->get_lower_bound(r2_origin, r2->destination) > r2->latest_alighting)
+                continue;
             
             Vehicle dummyVehicle(0, 0, 4, start_node);
 
-            pair<int,vector<NodeStop>> raw_path = routeplanner::travel(dummyVehicle, request_list, STANDARD,
-                    *network, time);
-            if (raw_path.first >= 0) // I.e., valid trip.
+            if (routeplanner::feasible(dummyVehicle, request_list, *network, time))
                 compatible_requests.push_back(r2);
         }
         
@@ -447,7 +514,19 @@ std::map<Vehicle*, Trip> assignment(
     map<Vehicle*, vector<Request*>> vr_edges;  // RV edges indexed by vehicle id.
     {
         map<Request*, vector<Vehicle*>> rv_edges;
-        struct rv_thread_data rv_data {time, &rv_edges, &network, &requests, &vehicles};
+        unique_ptr<VehicleGrid> grid;
+        bool reach = network.is_edge_bounded();  // Otherwise every vehicle is a candidate.
+        if (RV_CANDIDATES == RV_GRID && network.has_positions() && reach)
+            grid.reset(new VehicleGrid(network, vehicles));
+        vector<vector<int>> vehicles_at;
+        if (RV_CANDIDATES == RV_REACH && reach)
+        {
+            vehicles_at.resize(network.get_node_count());
+            for (auto i = 0; i < vehicles.size(); i++)
+                vehicles_at[vehicles[i]->node].push_back(i);
+        }
+        struct rv_thread_data rv_data {time, &rv_edges, &network, &requests, &vehicles, grid.get(),
+                (vehicles_at.size() ? &vehicles_at : NULL)};
         threads.auto_thread(requests.size(), make_rvgraph, (void*) &rv_data);
         
         for (auto x : rv_edges) // Invert the graph.
@@ -32,7 +32,7 @@
 
 using namespace std;
 
-vector<Vehicle> csvreader::load_vehicles()
+vector<Vehicle> csvreader::load_vehicles(Network const & network)
 {
     vector<Vehicle> vehicles;
     ifstream vfile(DATAROOT + "/vehicles/" + VEHICLE_DATA_FILE);
@@ -74,7 +74,7 @@ vector<Vehicle> csvreader::load_vehicles()
                 stoi(driver_id),
                 0,
                 vehicle_capacity, 
-                stoi(starting_node) - 1);
+                network.to_internal(stoi(starting_node) - 1));
 
         vehicles.push_back(vehicle);
         if (VEHICLE_LIMIT > 0 && ++count >= VEHICLE_LIMIT)
@@ -124,8 +124,8 @@ vector<Request> csvreader::load_requests(Network const & network)
         r.origin_latitude = stod(origin_latitude);
         r.destination_longitude = stod(destination_longitude);
         r.destination_latitude = stod(destination_latitude);
-        r.origin = stoi(origin_node) - 1;
-        r.destination = stoi(destination_node) - 1;
+        r.origin = network.to_internal(stoi(origin_node) - 1);
+        r.destination = network.to_internal(stoi(destination_node) - 1);
         
         r.id = stoi(request_id);
         r.entry_time = read_time(requested_time_string);
@@ -0,0 +1,431 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "hierarchy.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+using namespace std;
+
+namespace
+{
+int const INFINITE = numeric_limits<int>::max();
+int const WITNESS_SETTLE_LIMIT = 500;  // Bound on each witness search.  Extra shortcuts are harmless.
+int const CACHE_SETS = 1024;           // Per-thread query cache of CACHE_SETS * CACHE_WAYS entries.
+int const CACHE_WAYS = 4;
+
+typedef pair<int,int> entry;
+typedef priority_queue<entry, vector<entry>, greater<entry>> min_queue;
+
+struct DynamicEdge
+{
+    int target;
+    int weight;
+    int middle;  // -1 for an original edge.
+};
+
+uint64_t arc_key(int from, int to)
+{
+    return (uint64_t(from) << 32) | uint32_t(to);
+}
+
+/* Graph that shrinks as nodes are contracted, with in and out edges for each node. */
+struct Contraction
+{
+    vector<vector<DynamicEdge>> out;
+    vector<vector<DynamicEdge>> in;
+    vector<char> contracted;
+    vector<int> deleted_neighbors;
+    vector<int> distance;  // Witness search scratch space.
+    vector<int> touched;
+    
+    void add_edge(int from, int to, int weight, int middle)
+    {
+        for (auto & e : out[from])
+            if (e.target == to)
+            {
+                if (weight < e.weight)
+                {
+                    e.weight = weight;
+                    e.middle = middle;
+                    for (auto & r : in[to])
+                        if (r.target == from)
+                        {
+                            r.weight = weight;
+                            r.middle = middle;
+                        }
+                }
+                return;
+            }
+        out[from].push_back({to, weight, middle});
+        in[to].push_back({from, weight, middle});
+    }
+    
+    /* Bounded Dijkstra from source that avoids the node being contracted. */
+    void witness_search(int source, int skip, int limit)
+    {
+        for (auto x : touched)
+            distance[x] = INFINITE;
+        touched.clear();
+        distance[source] = 0;
+        touched.push_back(source);
+        min_queue queue;
+        queue.push(entry(0, source));
+        int settled = 0;
+        while (queue.size())
+        {
+            entry top = queue.top();
+            queue.pop();
+            int here = top.second;
+            if (top.first > distance[here])
+                continue;
+            if (top.first > limit || ++settled > WITNESS_SETTLE_LIMIT)
+                break;
+            for (auto & e : out[here])
+            {
+                if (contracted[e.target] || e.target == skip)
+                    continue;
+                int d = top.first + e.weight;
+                if (d < distance[e.target])
+                {
+                    if (distance[e.target] == INFINITE)
+                        touched.push_back(e.target);
+                    distance[e.target] = d;
+                    queue.push(entry(d, e.target));
+                }
+            }
+        }
+    }
+    
+    /* Shortcuts needed to remove node v.  They are only added when simulate is false. */
+    int contract(int v, bool simulate)
+    {
+        int shortcuts = 0;
+        for (size_t i = 0; i < in[v].size(); i++)
+        {
+            DynamicEdge incoming = in[v][i];
+            int u = incoming.target;
+            if (contracted[u])
+                continue;
+            int limit = -1;
+            for (auto & outgoing : out[v])
+                if (!contracted[outgoing.target] && outgoing.target != u)
+                    limit = max(limit, incoming.weight + outgoing.weight);
+            if (limit < 0)
+                continue;
+            
+            witness_search(u, v, limit);
+            for (size_t j = 0; j < out[v].size(); j++)
+            {
+                DynamicEdge outgoing = out[v][j];
+                int w = outgoing.target;
+                if (contracted[w] || w == u)
+                    continue;
+                int via = incoming.weight + outgoing.weight;
+                if (distance[w] > via)
+                {
+                    shortcuts++;
+                    if (!simulate)
+                        add_edge(u, w, via, v);
+                }
+            }
+        }
+        return shortcuts;
+    }
+    
+    int priority(int v)
+    {
+        int degree = 0;
+        for (auto & e : out[v])
+            degree += !contracted[e.target];
+        for (auto & e : in[v])
+            degree += !contracted[e.target];
+        return contract(v, true) - degree + deleted_neighbors[v];
+    }
+};
+
+struct CacheEntry
+{
+    uint64_t key;
+    int value;
+    uint32_t stamp;
+};
+
+/* Set associative cache with least recently used replacement within each set. */
+struct QueryCache
+{
+    void const* owner;
+    uint32_t clock;
+    vector<CacheEntry> entries;
+    
+    QueryCache() : owner (NULL), clock (0) {}
+    
+    void reset(void const* new_owner)
+    {
+        owner = new_owner;
+        clock = 0;
+        entries.assign(CACHE_SETS * CACHE_WAYS, CacheEntry {numeric_limits<uint64_t>::max(), 0, 0});
+    }
+    
+    CacheEntry* find_set(uint64_t key)
+    {
+        uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+        return &entries[(hash >> 40) % CACHE_SETS * CACHE_WAYS];
+    }
+};
+
+struct QueryScratch
+{
+    vector<int> distance[2];
+    vector<int> parent[2];
+    vector<entry> queue[2];  // Binary heaps ordered by greater<entry>, kept to reuse their capacity.
+    vector<int> touched;
+};
+}
+
+ContractionHierarchy::ContractionHierarchy(vector<vector<pair<int,int>>> const & edges) :
+        node_count (edges.size())
+{
+    for (auto & list : edges)
+        for (auto & e : list)
+            node_count = max(node_count, e.first + 1);
+    
+    Contraction graph;
+    graph.out.resize(node_count);
+    graph.in.resize(node_count);
+    graph.contracted.assign(node_count, 0);
+    graph.deleted_neighbors.assign(node_count, 0);
+    graph.distance.assign(node_count, INFINITE);
+    for (int origin = 0; origin < edges.size(); origin++)
+        for (auto & e : edges[origin])
+            if (e.first != origin)
+                graph.add_edge(origin, e.first, e.second, -1);
+    
+    // Lazy updates: a popped node is re-evaluated and contracted only if it is still the cheapest.
+    min_queue order;
+    for (int v = 0; v < node_count; v++)
+        order.push(entry(graph.priority(v), v));
+    
+    vector<vector<Arc>> forward(node_count), backward(node_count);
+    while (order.size())
+    {
+        int v = order.top().second;
+        order.pop();
+        if (graph.contracted[v])
+            continue;
+        int current = graph.priority(v);
+        if (order.size() && current > order.top().first)
+        {
+            order.push(entry(current, v));
+            continue;
+        }
+        
+        graph.contract(v, false);
+        for (auto & e : graph.out[v])  // Remaining neighbors all rank above v.
+            if (!graph.contracted[e.target])
+            {
+                forward[v].push_back({e.target, e.weight});
+                if (e.middle >= 0)
+                    middles[arc_key(v, e.target)] = e.middle;
+                graph.deleted_neighbors[e.target]++;
+            }
+        for (auto & e : graph.in[v])
+            if (!graph.contracted[e.target])
+            {
+                backward[v].push_back({e.target, e.weight});
+                if (e.middle >= 0)
+                    middles[arc_key(e.target, v)] = e.middle;
+                graph.deleted_neighbors[e.target]++;
+            }
+        graph.contracted[v] = 1;
+        vector<DynamicEdge>().swap(graph.out[v]);  // Nothing will look at these again.
+        vector<DynamicEdge>().swap(graph.in[v]);
+    }
+    
+    for (int v = 0; v < node_count; v++)
+    {
+        forward_first.push_back(forward_arcs.size());
+        forward_arcs.insert(forward_arcs.end(), forward[v].begin(), forward[v].end());
+        backward_first.push_back(backward_arcs.size());
+        backward_arcs.insert(backward_arcs.end(), backward[v].begin(), backward[v].end());
+    }
+    forward_first.push_back(forward_arcs.size());
+    backward_first.push_back(backward_arcs.size());
+}
+
+int ContractionHierarchy::get_time(int origin, int destination) const
+{
+    if (origin == destination)
+        return 0;
+    
+    static thread_local QueryCache cache;
+    if (cache.owner != this)
+        cache.reset(this);
+    uint64_t key = arc_key(origin, destination);
+    CacheEntry* set = cache.find_set(key);
+    CacheEntry* oldest = set;
+    for (int way = 0; way < CACHE_WAYS; way++)
+    {
+        if (set[way].key == key)
+        {
+            set[way].stamp = ++cache.clock;
+            return set[way].value;
+        }
+        if (set[way].stamp < oldest->stamp)
+            oldest = &set[way];
+    }
+    
+    int time = query(origin, destination, NULL);
+    *oldest = CacheEntry {key, time, ++cache.clock};
+    return time;
+}
+
+vector<int> ContractionHierarchy::get_path(int origin, int destination) const
+{
+    vector<int> path {origin};
+    if (origin != destination)
+        query(origin, destination, &path);
+    return path;
+}
+
+int ContractionHierarchy::query(int origin, int destination, vector<int>* path) const
+{
+    static thread_local QueryScratch scratch;
+    if (scratch.distance[0].size() != node_count)
+        for (int side = 0; side < 2; side++)
+        {
+            scratch.distance[side].assign(node_count, INFINITE);
+            scratch.parent[side].assign(node_count, -1);
+        }
+    vector<int>* distance = scratch.distance;
+    vector<int>* parent = scratch.parent;
+    vector<entry>* queue = scratch.queue;
+    greater<entry> order;
+    
+    distance[0][origin] = 0;
+    distance[1][destination] = 0;
+    scratch.touched.push_back(origin);
+    scratch.touched.push_back(destination);
+    queue[0].assign(1, entry(0, origin));
+    queue[1].assign(1, entry(0, destination));
+    
+    int best = INFINITE;
+    int meeting = -1;
+    while (queue[0].size() || queue[1].size())
+    {
+        int side = (queue[0].size() && (!queue[1].size() || queue[0][0].first <= queue[1][0].first)) ? 0 : 1;
+        pop_heap(queue[side].begin(), queue[side].end(), order);
+        entry top = queue[side].back();
+        queue[side].pop_back();
+        int here = top.second;
+        if (top.first > distance[side][here])
+            continue;
+        if (top.first >= best)  // Nothing further on this side can improve the answer.
+        {
+            queue[side].clear();
+            continue;
+        }
+        if (distance[1 - side][here] != INFINITE && top.first + distance[1 - side][here] < best)
+        {
+            best = top.first + distance[1 - side][here];
+            meeting = here;
+        }
+        
+        vector<int> const & first = (side == 0 ? forward_first : backward_first);
+        vector<Arc> const & arcs = (side == 0 ? forward_arcs : backward_arcs);
+        
+        // Stall on demand: skip the node if a higher ranked node already reaches it more cheaply.
+        vector<int> const & other_first = (side == 0 ? backward_first : forward_first);
+        vector<Arc> const & other_arcs = (side == 0 ? backward_arcs : forward_arcs);
+        bool stalled = false;
+        for (int a = other_first[here]; a < other_first[here + 1] && !stalled; a++)
+        {
+            int d = distance[side][other_arcs[a].target];
+            stalled = (d != INFINITE && d + other_arcs[a].weight < top.first);
+        }
+        if (stalled)
+            continue;
+        
+        for (int a = first[here]; a < first[here + 1]; a++)
+        {
+            int d = top.first + arcs[a].weight;
+            int next = arcs[a].target;
+            if (d < distance[side][next])
+            {
+                if (distance[0][next] == INFINITE && distance[1][next] == INFINITE)
+                    scratch.touched.push_back(next);
+                distance[side][next] = d;
+                parent[side][next] = here;
+                queue[side].push_back(entry(d, next));
+                push_heap(queue[side].begin(), queue[side].end(), order);
+            }
+        }
+    }
+    
+    if (path != NULL && meeting != -1)
+    {
+        vector<int> up;  // Meeting node back down to the origin.
+        for (int x = meeting; x != origin; x = parent[0][x])
+            up.push_back(x);
+        up.push_back(origin);
+        for (auto i = up.size() - 1; i > 0; i--)
+            unpack(up[i], up[i - 1], *path);
+        for (int x = meeting; x != destination; x = parent[1][x])
+            unpack(x, parent[1][x], *path);
+    }
+    
+    for (auto x : scratch.touched)
+    {
+        distance[0][x] = distance[1][x] = INFINITE;
+        parent[0][x] = parent[1][x] = -1;
+    }
+    scratch.touched.clear();
+    return (best == INFINITE ? UNREACHABLE : best);
+}
+
+/* Expand an arc of the hierarchy into original edges, appending every node after from. */
+void ContractionHierarchy::unpack(int from, int to, vector<int> & path) const
+{
+    auto middle = middles.find(arc_key(from, to));
+    if (middle == middles.end())
+    {
+        path.push_back(to);
+        return;
+    }
+    unpack(from, middle->second, path);
+    unpack(middle->second, to, path);
+}
+
+int ContractionHierarchy::get_node_count() const
+{
+    return node_count;
+}
+
+int ContractionHierarchy::get_edge_count() const
+{
+    return forward_arcs.size() + backward_arcs.size();
+}
@@ -0,0 +1,155 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "landmarks.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+using namespace std;
+
+namespace
+{
+int const INFINITE = numeric_limits<int32_t>::max();
+
+typedef vector<vector<pair<int,int>>> edge_list;
+
+/* Travel times from source to every node, INFINITE where there is no route. */
+void search(edge_list const & edges, int source, vector<int32_t> & times)
+{
+    typedef pair<int,int> entry;
+    times.assign(edges.size(), INFINITE);
+    times[source] = 0;
+    priority_queue<entry, vector<entry>, greater<entry>> queue;
+    queue.push(entry(0, source));
+    while (queue.size())
+    {
+        entry top = queue.top();
+        queue.pop();
+        int here = top.second;
+        if (top.first > times[here])
+            continue;
+        for (auto & e : edges[here])
+            if (top.first + e.second < times[e.first])
+            {
+                times[e.first] = top.first + e.second;
+                queue.push(entry(times[e.first], e.first));
+            }
+    }
+}
+
+struct landmark_thread_data
+{
+    edge_list const* reversed;
+    vector<int> const* landmarks;
+    vector<int32_t>* to_landmark;
+};
+
+/* Backward searches, one per landmark.  Each writes its own column of to_landmark. */
+void landmark_dispatch(void* landmark_data)
+{
+    struct thread_data* t = (struct thread_data*) landmark_data;
+    int start = t->start;
+    int end = t->end;
+    
+    struct landmark_thread_data* data = (struct landmark_thread_data*) t->data;
+    auto & landmarks = *data->landmarks;
+    auto & to_landmark = *data->to_landmark;
+    int count = landmarks.size();
+    
+    vector<int32_t> times;
+    for (int l = start; l < end; l++)
+    {
+        search(*data->reversed, landmarks[l], times);
+        for (auto i = 0; i < times.size(); i++)
+            to_landmark[size_t(i) * count + l] = times[i];
+    }
+}
+}
+
+Landmarks::Landmarks(edge_list const & edges, int landmark_count, Threads & threads) :
+        count (min(landmark_count, int(edges.size())))
+{
+    int node_count = edges.size();
+    from_landmark.assign(size_t(node_count) * count, INFINITE);
+    to_landmark.assign(size_t(node_count) * count, INFINITE);
+    if (!count)
+        return;
+    
+    // Farthest point selection.  Start from the node farthest from node 0, then repeatedly take the node
+    // farthest from every landmark chosen so far.  Each choice depends on the last search, so this is serial.
+    vector<int> landmarks;
+    vector<int32_t> times, nearest (node_count, INFINITE);
+    search(edges, 0, times);
+    int next = max_element(times.begin(), times.end(), [](int32_t a, int32_t b) {
+            return (b != INFINITE && (a == INFINITE || a < b)); }) - times.begin();
+    for (auto l = 0; l < count; l++)
+    {
+        landmarks.push_back(next);
+        search(edges, next, times);
+        next = -1;
+        for (auto i = 0; i < node_count; i++)
+        {
+            from_landmark[size_t(i) * count + l] = times[i];
+            nearest[i] = min(nearest[i], times[i]);
+            if (nearest[i] != INFINITE && (next == -1 || nearest[i] > nearest[next]))
+                next = i;
+        }
+        if (next == -1 || nearest[next] == 0)  // Every reachable node is already a landmark.
+            next = landmarks[0];
+    }
+    
+    edge_list reversed (node_count);
+    for (auto i = 0; i < node_count; i++)
+        for (auto & e : edges[i])
+            reversed[e.first].push_back(make_pair(i, e.second));
+    struct landmark_thread_data landmark_data {&reversed, &landmarks, &to_landmark};
+    threads.auto_thread(count, landmark_dispatch, (void*) &landmark_data);
+}
+
+int Landmarks::get_lower_bound(int origin, int destination) const
+{
+    // d(l,b) <= d(l,a) + d(a,b) and d(a,l) <= d(a,b) + d(b,l), for every landmark l reaching or reached by both.
+    int32_t const* from_a = &from_landmark[size_t(origin) * count];
+    int32_t const* from_b = &from_landmark[size_t(destination) * count];
+    int32_t const* to_a = &to_landmark[size_t(origin) * count];
+    int32_t const* to_b = &to_landmark[size_t(destination) * count];
+    int bound = 0;
+    for (auto l = 0; l < count; l++)
+    {
+        if (from_a[l] != INFINITE && from_b[l] != INFINITE)
+            bound = max(bound, from_b[l] - from_a[l]);
+        if (to_a[l] != INFINITE && to_b[l] != INFINITE)
+            bound = max(bound, to_a[l] - to_b[l]);
+    }
+    return bound;
+}
+
+int Landmarks::get_count() const
+{
+    return count;
+}
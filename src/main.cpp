@@ -58,7 +58,10 @@ int main(int argc, char *argv[])
         results << "RESULTS_DIRECTORY " << RESULTS_DIRECTORY << endl;
         results << "RH" << RH << endl;
         results << "TIMEFILE " << TIMEFILE << endl;
+        results << "DISTANCEFILE " << (DISTANCEFILE.size() ? DISTANCEFILE : "(travel times)") << endl;
         results << "EDGECOST_FILE " << EDGECOST_FILE << endl;
+        if (BUILD_MATRIX)
+            results << "BUILD_MATRIX Active" << endl;
         results << "VEHICLE_LIMIT " << VEHICLE_LIMIT << endl;
         results << "MAX_WAITING " << MAX_WAITING << endl;
         results << "MAX_DETOUR " << MAX_DETOUR << endl;
@@ -88,9 +91,17 @@ int main(int argc, char *argv[])
             case FIX_PREFIX:
                 results << "FIX_PREFIX" << endl;
                 break;
+            case MEGA_TSP:
+                results << "MEGA_TSP" << endl;
+                break;
+            case FULL_DP:
+                results << "FULL_DP" << endl;
+                break;
             default:
                 results << "UNLABELED" << endl;
         }
+        results << "TIME_PROFILES " << TIME_PROFILES << endl;
+        results << "NETWORK_BACKEND " << (NETWORK_BACKEND == NB_HIERARCHY ? "HIERARCHY" : "MATRIX") << endl;
         results << "CTSP_OBJECTIVE ";
         if (CTSP_OBJECTIVE == CTSP_VMT)
             results << "CTSP_VMT" << endl;
@@ -115,12 +126,12 @@ int main(int argc, char *argv[])
 
     // Set up routing matrix.
     info("Setting up network...", White);
-    Network network;
+    Network network(threads);
     info("Network was loaded!", Purple);
 
     // Load all the vehicles and requests for the simulation.
     info("Loading vehicles and requests...", White);
-    vector<Vehicle> vehicles = csvreader::load_vehicles();
+    vector<Vehicle> vehicles = csvreader::load_vehicles(network);
     vector<Request> requests = csvreader::load_requests(network);
     vector<Request *> active_requests; // Holds requests across iterations.
     info("Vehicles and requests were loaded!", Purple);
@@ -162,6 +173,7 @@ int main(int argc, char *argv[])
 
         clock_iteration_start = std::chrono::high_resolution_clock::now();
         clock_start = std::chrono::high_resolution_clock::now();
+        routeplanner::clear_cache();  // Vehicles and requests have moved on since the last epoch.
 
         // Get the set of active vehicles and new requests for this iteration.
         info("Running buffer update", Yellow);
@@ -243,7 +255,8 @@ int main(int argc, char *argv[])
             ofstream rb(RESULTS_DIRECTORY + "/rebalance.log", ios_base::app);
             rb << "TIME STAMP " << encode_time(time) << endl;
             for (auto & x : rebalancing_trips)
-                rb << "{'v':" << x.first->id << ",'t':" << x.second.requests[0]->origin << "}" << endl;
+                rb << "{'v':" << x.first->id << ",'t':" << network.to_external(x.second.requests[0]->origin)
+                        << "}" << endl;
         }
 
         clock_stop = std::chrono::high_resolution_clock::now();
@@ -0,0 +1,292 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "matrix.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+char const MATRIX_MAGIC[8] = {'R', 'H', 'M', 'A', 'T', 'R', 'I', 'X'};
+uint32_t const MATRIX_VERSION = 1;
+
+template <typename T>
+T checked_cell(long value, string const & filename)
+{
+    if (value < long(numeric_limits<T>::min()) || value > long(numeric_limits<T>::max()))
+        throw runtime_error("Matrix entry " + to_string(value) + " in " + filename +
+                " does not fit the matrix cell type.  Use a wider cell type (see network.hpp).");
+    return T(value);
+}
+
+template <typename T, typename S>
+void convert_cells(vector<T> & storage, void const* cells, size_t count, string const & filename)
+{
+    S const* source = (S const*) cells;
+    storage.resize(count);
+    for (size_t i = 0; i < count; i++)
+        storage[i] = checked_cell<T>(long(source[i]), filename);
+}
+}
+
+bool is_binary_matrix(string const & filename)
+{
+    ifstream file(filename, ios::binary);
+    char magic[sizeof(MATRIX_MAGIC)];
+    if (!file.read(magic, sizeof(magic)))
+        return false;
+    return memcmp(magic, MATRIX_MAGIC, sizeof(magic)) == 0;
+}
+
+template <typename T>
+Matrix<T>::Matrix() :
+        mapping (NULL),
+        mapping_size (0),
+        data (NULL),
+        rows (0),
+        cols (0)
+{}
+
+template <typename T>
+Matrix<T>::~Matrix()
+{
+    release();
+}
+
+template <typename T>
+void Matrix<T>::release()
+{
+    if (mapping != NULL)
+        munmap(mapping, mapping_size);
+    mapping = NULL;
+    mapping_size = 0;
+    storage.clear();
+    data = NULL;
+    rows = cols = 0;
+}
+
+template <typename T>
+void Matrix<T>::load(string const & filename)
+{
+    release();
+    if (is_binary_matrix(filename))
+        map_binary(filename);
+    else
+        load_csv(filename);
+}
+
+template <typename T>
+void Matrix<T>::allocate(int rows, int cols, T value)
+{
+    release();
+    storage.assign(size_t(rows) * cols, value);
+    this->rows = rows;
+    this->cols = cols;
+    data = storage.data();
+}
+
+template <typename T>
+void Matrix<T>::attach(T const* cells, int rows, int cols)
+{
+    release();
+    this->rows = rows;
+    this->cols = cols;
+    data = cells;
+}
+
+template <typename T>
+void Matrix<T>::permute(vector<int> const & order)
+{
+    if (rows != cols || order.size() != rows)
+        throw runtime_error("Only a square matrix can be permuted, by an order covering every row.");
+    vector<T> permuted(size_t(rows) * cols);
+    for (auto i = 0; i < rows; i++)
+    {
+        T const* row = get_row(order[i]);
+        T* target = permuted.data() + size_t(i) * cols;
+        for (auto j = 0; j < cols; j++)
+            target[j] = row[order[j]];
+    }
+    int size = rows;
+    release();
+    storage.swap(permuted);
+    rows = cols = size;
+    data = storage.data();
+}
+
+template <typename T>
+void Matrix<T>::load_csv(string const & filename)
+{
+    ifstream file(filename);
+    if (!file.is_open())
+        throw runtime_error("Unable to open matrix file " + filename);
+    
+    string line;
+    while (getline(file, line))
+    {
+        if (!line.size())
+            continue;
+        int count = 0;
+        char const* c = line.c_str();
+        while (*c)
+        {
+            char* end;
+            long value = strtol(c, &end, 10);
+            if (end == c)
+                throw runtime_error("Could not parse matrix entry in " + filename);
+            storage.push_back(checked_cell<T>(value, filename));
+            count++;
+            c = end;
+            while (*c == ',' || *c == ' ' || *c == '\r')
+                c++;
+        }
+        if (rows == 0)
+        {
+            cols = count;
+            storage.reserve(size_t(cols) * cols);
+        }
+        else if (count != cols)
+            throw runtime_error("Ragged row in matrix file " + filename);
+        rows++;
+    }
+    data = storage.data();
+}
+
+template <typename T>
+void Matrix<T>::map_binary(string const & filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error("Unable to open matrix file " + filename);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(MatrixHeader))
+    {
+        close(fd);
+        throw runtime_error("Binary matrix file is truncated: " + filename);
+    }
+    
+    void* region = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // The mapping keeps its own reference to the file.
+    if (region == MAP_FAILED)
+        throw runtime_error("Unable to memory-map matrix file " + filename);
+    
+    // Dimensions must fit an int, and the cells the file, before either is trusted.
+    MatrixHeader const* header = (MatrixHeader const*) region;
+    uint64_t const largest = numeric_limits<int>::max();
+    bool fits = (header->version == MATRIX_VERSION && (header->cell_bytes == 1 || header->cell_bytes == 2 || header->cell_bytes == 4) &&
+            header->rows <= largest && header->cols <= largest);
+    uint64_t count = (fits ? header->rows * header->cols : 0);  // Below 2^62, so the product cannot overflow.
+    if (!fits || count > (uint64_t(st.st_size) - sizeof(MatrixHeader)) / header->cell_bytes)
+    {
+        munmap(region, st.st_size);
+        throw runtime_error("Binary matrix file has an unsupported layout: " + filename);
+    }
+    rows = header->rows;
+    cols = header->cols;
+    void const* cells = (char const*) region + sizeof(MatrixHeader);
+    
+    if (header->cell_bytes == sizeof(T))  // Use the file directly.
+    {
+        mapping = region;
+        mapping_size = st.st_size;
+        data = (T const*) cells;
+        return;
+    }
+    
+    // Otherwise widen or narrow into private storage.  This loses page sharing between processes.
+    try
+    {
+        if (header->cell_bytes == 1)
+            convert_cells<T, uint8_t>(storage, cells, count, filename);
+        else if (header->cell_bytes == 2)
+            convert_cells<T, uint16_t>(storage, cells, count, filename);
+        else
+            convert_cells<T, int32_t>(storage, cells, count, filename);
+    }
+    catch (...)
+    {
+        munmap(region, st.st_size);
+        throw;
+    }
+    munmap(region, st.st_size);
+    data = storage.data();
+}
+
+template <typename T>
+void Matrix<T>::save(string const & filename) const
+{
+    // Written beside the target and renamed over it, so processes mapping the old file keep reading it whole.
+    string temporary = filename + ".tmp." + to_string(getpid());
+    ofstream file(temporary, ios::binary | ios::trunc);
+    if (!file.is_open())
+        throw runtime_error("Unable to open " + temporary + " for writing.");
+    
+    MatrixHeader header {};
+    memcpy(header.magic, MATRIX_MAGIC, sizeof(MATRIX_MAGIC));
+    header.version = MATRIX_VERSION;
+    header.cell_bytes = sizeof(T);
+    header.rows = rows;
+    header.cols = cols;
+    file.write((char const*) &header, sizeof(header));
+    file.write((char const*) data, size_t(rows) * cols * sizeof(T));
+    file.close();
+    if (!file || rename(temporary.c_str(), filename.c_str()) != 0)
+    {
+        remove(temporary.c_str());
+        throw runtime_error("Failed while writing matrix file " + filename);
+    }
+}
+
+template <typename T>
+int Matrix<T>::get_rows() const
+{
+    return rows;
+}
+
+template <typename T>
+int Matrix<T>::get_cols() const
+{
+    return cols;
+}
+
+template <typename T>
+bool Matrix<T>::is_mapped() const
+{
+    return mapping != NULL;
+}
+
+template class Matrix<uint8_t>;
+template class Matrix<uint16_t>;
+template class Matrix<int32_t>;
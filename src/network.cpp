@@ -22,77 +22,289 @@
  * THE SOFTWARE.
  */
  
+#include "formatting.hpp"
 #include "network.hpp"
+#include "ordering.hpp"
+#include "sharedmemory.hpp"
 #include "settings.hpp"
+#include "shortestpath.hpp"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <iostream>
 #include <fstream>
+#include <limits>
 #include <map>
+#include <mutex>
+#include <numeric>
+#include <cmath>
 #include <math.h>
 #include <queue>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <sys/stat.h>
 #include <boost/algorithm/string.hpp>
  
 using namespace std;
 using namespace boost;
  
-Network::Network()
-{  
+namespace
+{
+/* A cache is fresh if it exists and is not older than the edge file it was built from. */
+bool is_fresh_cache(string const & cachefile, string const & sourcefile)
+{
+    struct stat cache_stat, source_stat;
+    if (stat(cachefile.c_str(), &cache_stat) != 0)
+        return false;
+    if (stat(sourcefile.c_str(), &source_stat) != 0)
+        return true;
+    return cache_stat.st_mtime >= source_stat.st_mtime;
+}
+
+template <typename T>
+void save_cache(Matrix<T> & matrix, string const & cachefile)
+{
+    ifstream existing(cachefile);
+    if (existing.is_open() && !is_binary_matrix(cachefile))
+        throw runtime_error("Refusing to overwrite " + cachefile + " which is not a binary matrix cache.");
+    try
+    {
+        matrix.save(cachefile);
+        matrix.load(cachefile);  // Swap the private copy for a shared mapping.
+    }
+    catch (runtime_error const & e)
+    {
+        info(string("Could not write cache: ") + e.what(), Red);
+    }
+}
+
+/* Project the latitude and longitude of each node onto a plane around their mean latitude.  Leaves positions
+   empty unless every node gets one. */
+void load_positions(string const & nodefile, int node_count, vector<Point> & positions)
+{
+    ifstream file(nodefile);
+    if (!file.is_open())
+    {
+        info("No node coordinates in " + nodefile + ", the vehicle grid is off.", Red);
+        return;
+    }
+    vector<double> latitude(node_count, NAN), longitude(node_count, NAN);
     string line;
-    ifstream timefile(DATAROOT + "/map/" + TIMEFILE);
-    if (!timefile.is_open())
-        throw runtime_error("Unable to open matrix file");
-    
-    int rowsize = 0;
-    while (getline(timefile, line))
+    while (getline(file, line))
     {
-        vector<int> row;
-        row.reserve(rowsize);
-        
-        char * cstr = new char [line.length() + 1];
-        std::strcpy(cstr, line.c_str());
-        
-        char* token;
-        token = strtok(cstr, ",");
-        while (token != NULL)
+        vector<string> fields;
+        split(fields, line, is_any_of(","));
+        int node = stoi(fields[0]) - 1;
+        if (node >= 0 && node < node_count)
         {
-            int entry_value = stoi(token);
-            row.push_back(entry_value);
-            token = strtok(NULL, ",");
+            latitude[node] = stod(fields[1]);
+            longitude[node] = stod(fields[2]);
         }
-        delete[] cstr;
-        time_matrix.push_back(row);
     }
     
-    // WE ARE NOT USING DISTANCE HERE YET, SO JUST DUPLICATING TIME.
-    //ifstream distancefile(DATAROOT + "/map/times.csv"); // full_distances.csv");
-    ifstream distancefile(DATAROOT + "/map/" + TIMEFILE);
-    if (!distancefile.is_open())
-        throw runtime_error("Unable to open distances matrix file.");
-    
-    while (getline(distancefile, line))
+    double const radius = 6371000, degree = M_PI / 180;
+    double mean_latitude = 0;
+    for (auto i = 0; i < node_count; i++)
     {
-        vector<int> row;
-        row.reserve(rowsize);
-        
-        char * cstr = new char [line.length() + 1];
-        std::strcpy(cstr, line.c_str());
-        
-        char* token;
-        token = strtok(cstr, ",");
-        while (token != NULL)
+        if (std::isnan(latitude[i]))
         {
-            int entry_value = stoi(token);
-            row.push_back(entry_value);
-            token = strtok(NULL, ",");
+            info("Node " + to_string(i + 1) + " is missing from " + nodefile + ", the vehicle grid is off.", Red);
+            return;
         }
-        delete[] cstr;
-        distance_matrix.push_back(row);
+        mean_latitude += latitude[i] / node_count;
     }
-    
-    ifstream edgefile(DATAROOT + "/map/" + EDGECOST_FILE);
+    double scale = radius * degree * cos(mean_latitude * degree);
+    positions.resize(node_count);
+    for (auto i = 0; i < node_count; i++)
+        positions[i] = {longitude[i] * scale, latitude[i] * radius * degree};
+}
+
+/* Per-thread state of get_reverse_reach.  Only the touched entries are reset, so a search costs as much as
+   the neighbourhood it visits. */
+struct ReachScratch
+{
+    vector<int> time;
+    vector<int> touched;
+    vector<pair<int,int>> heap;
+};
+
+struct transpose_thread_data
+{
+    Matrix<time_cell_t> const* source;
+    Matrix<time_cell_t>* target;
+};
+
+/* Fill target rows start to end, a band at a time so both sides are read and written in runs. */
+void transpose_dispatch(void* transpose_data)
+{
+    struct thread_data* t = (struct thread_data*) transpose_data;
+    struct transpose_thread_data* data = (struct transpose_thread_data*) t->data;
+    int const band = 64;
+    for (auto first = t->start; first < t->end; first += band)
+    {
+        int last = min(first + band, t->end);
+        for (auto i = 0; i < data->source->get_rows(); i++)
+        {
+            time_cell_t const* row = data->source->get_row(i);
+            for (auto j = first; j < last; j++)
+                data->target->set(j, i, row[j]);
+        }
+    }
+}
+
+/* Blocks of the shared network segment. */
+enum SharedBlockIndex {SHARED_ORDER, SHARED_TIMES, SHARED_TRANSPOSED, SHARED_SUCCESSORS, SHARED_PROFILES,
+        SHARED_DISTANCES, SHARED_BLOCKS};
+
+/* The travel time matrix to read.  With BUILD_MATRIX, a .csv name becomes .bin so the binary cache never
+   takes the place of a text matrix. */
+string time_file()
+{
+    string timefile = DATAROOT + "/map/" + TIMEFILE;
+    if (BUILD_MATRIX && timefile.size() > 4 && timefile.compare(timefile.size() - 4, 4, ".csv") == 0)
+        timefile.replace(timefile.size() - 4, 4, ".bin");
+    return timefile;
+}
+
+/* Size and modification time of a file in the map directory, or "-" if there is none. */
+string file_stamp(string const & filename)
+{
+    struct stat file_stat;
+    if (!filename.size() || stat(filename.c_str(), &file_stat) != 0)
+        return "-";
+    return to_string(file_stat.st_size) + ":" + to_string(file_stat.st_mtime);
+}
+
+/* Every setting and input file that changes what the shared segment holds.  Processes only share with
+   identical inputs, so a file rewritten under the same name needs a new segment. */
+string shared_signature()
+{
+    string map = DATAROOT + "/map/";
+    stringstream signature;
+    signature << DATAROOT << "|" << EDGECOST_FILE << "|" << TIMEFILE << "|" << DISTANCEFILE << "|" << NODES_FILE
+            << "|" << NODE_ORDER << "|" << TRANSPOSED_MATRIX << "|" << SUCCESSOR_TABLE << "|" << SUCCESSORFILE
+            << "|" << TIME_PROFILES << "|" << TIME_PROFILE_PREFIX << "|" << BUILD_MATRIX << "|"
+            << sizeof(time_cell_t) << "|" << sizeof(node_cell_t);
+    signature << "|" << file_stamp(map + EDGECOST_FILE) << "|" << file_stamp(time_file()) << "|"
+            << file_stamp(DISTANCEFILE.size() ? map + DISTANCEFILE : "") << "|"
+            << file_stamp(NODES_FILE.size() ? map + NODES_FILE : "") << "|"
+            << file_stamp(SUCCESSOR_TABLE ? map + SUCCESSORFILE : "");
+    for (auto p = 0; p < TIME_PROFILES; p++)
+        signature << "|" << file_stamp(map + TIME_PROFILE_PREFIX + to_string(p) + ".csv");
+    return signature.str();
+}
+
+template <typename T>
+SharedBlock describe(Matrix<T> const & matrix)
+{
+    return {0, uint64_t(matrix.get_rows()) * matrix.get_cols() * sizeof(T), matrix.get_rows(), matrix.get_cols()};
+}
+
+template <typename T>
+void copy_cells(Matrix<T> const & matrix, void* target)
+{
+    if (matrix.get_rows())
+        memcpy(target, matrix.get_row(0), size_t(matrix.get_rows()) * matrix.get_cols() * sizeof(T));
+}
+
+template <typename T>
+void adopt(Matrix<T> & matrix, SharedSegment const & segment, int index)
+{
+    SharedBlock block = segment.get_block(index);
+    if (block.rows)
+        matrix.attach((T const*) segment.get_data(index), block.rows, block.cols);
+}
+
+/* Store profile as multiples of 1/64 of base in rows first_row onward of factors.  Returns the largest
+   rounding error in seconds. */
+int quantize_profile(Matrix<time_cell_t> const & base, Matrix<time_cell_t> const & profile,
+        Matrix<profile_cell_t> & factors, int first_row)
+{
+    int const unit = 1 << PROFILE_SHIFT;
+    int const largest = numeric_limits<profile_cell_t>::max();
+    int worst = 0;
+    for (auto i = 0; i < base.get_rows(); i++)
+        for (auto j = 0; j < base.get_cols(); j++)
+        {
+            int b = base.get(i, j), t = profile.get(i, j);
+            int factor = (b ? min((t * unit + b / 2) / b, largest) : unit);
+            factors.set(first_row + i, j, factor);
+            worst = max(worst, abs(((b * factor + unit / 2) >> PROFILE_SHIFT) - t));
+        }
+    return worst;
+}
+}
+
+struct shortcut_thread_data
+{
+    vector<vector<neighbor>> const* graph;
+    Matrix<time_cell_t> const* times;
+    vector<int>* shortcuts;
+};
+
+/* For sources start to end, count the pairs whose travel time in times is below the time of the fastest
+   route over the edges, as build_times would store it. */
+void shortcut_dispatch(void* shortcut_data)
+{
+    struct thread_data* t = (struct thread_data*) shortcut_data;
+    struct shortcut_thread_data* data = (struct shortcut_thread_data*) t->data;
+    vector<vector<neighbor>> const & graph = *data->graph;
+    int node_count = graph.size();
+    weight_t const infinity = numeric_limits<weight_t>::infinity();
+    time_cell_t const max_time = numeric_limits<time_cell_t>::max();
+    vector<weight_t> distance(node_count);
+    typedef pair<weight_t,int> entry;
+    for (auto source = t->start; source < t->end; source++)
+    {
+        fill(distance.begin(), distance.end(), infinity);
+        distance[source] = 0;
+        priority_queue<entry, vector<entry>, greater<entry>> queue;
+        queue.push(entry(0, source));
+        while (queue.size())
+        {
+            entry top = queue.top();
+            queue.pop();
+            if (top.first > distance[top.second])
+                continue;
+            for (auto & n : graph[top.second])
+                if (top.first + n.weight < distance[n.target])
+                {
+                    distance[n.target] = top.first + n.weight;
+                    queue.push(entry(distance[n.target], n.target));
+                }
+        }
+        int count = 0;
+        for (auto node = 0; node < node_count; node++)
+        {
+            int edge_time = (distance[node] < max_time ? int(distance[node]) : max_time);
+            if (data->times->get(source, node) < edge_time)
+                count++;
+        }
+        (*data->shortcuts)[source] = count;
+    }
+}
+
+/* Pairs of nodes whose travel time in times beats every route over the edges.  One Dijkstra search per
+   node, like build_times. */
+int64_t count_edge_shortcuts(vector<vector<neighbor>> const & adjacency_list, Matrix<time_cell_t> const & times,
+        Threads & threads)
+{
+    vector<int> shortcuts(adjacency_list.size(), 0);
+    struct shortcut_thread_data data {&adjacency_list, &times, &shortcuts};
+    threads.auto_thread(adjacency_list.size(), shortcut_dispatch, (void*) &data);
+    return accumulate(shortcuts.begin(), shortcuts.end(), int64_t(0));
+}
+
+Network::Network(Threads & threads) : reach_speed(0), reach_margin(0), edge_bounded(true), profile_count(0),
+        profile_period(1), profile_floor(1 << PROFILE_SHIFT)
+{  
+    string line;
+    string edgecost_file = DATAROOT + "/map/" + EDGECOST_FILE;
+    ifstream edgefile(edgecost_file);
+    int node_count = 0;
     if (edgefile.is_open())
     {
         while (getline(edgefile, line))
@@ -107,40 +319,424 @@ Network::Network()
                 adjacency_list.resize(origin + 1);
             
             adjacency_list[origin].push_back(neighbor(dest, length));
+            node_count = max(node_count, max(origin, dest) + 1);
         }
     }
     else
         throw runtime_error("Unable to open file for dijkstra shortest path calculation.");
+    
+    // With SHARED_NETWORK, a process that finds the segment takes every matrix from it and only rebuilds the
+    // edge lists.  Otherwise it loads as usual and publishes what it loaded at the end.
+    bool attached = false;
+    if (SHARED_NETWORK.size())
+    {
+        if (NETWORK_BACKEND == NB_HIERARCHY)
+            throw runtime_error("SHARED_NETWORK requires the MATRIX network backend.");
+        shared_segment.reset(new SharedSegment());
+        attached = shared_segment->attach(SHARED_NETWORK, shared_signature());
+        if (attached)
+            info("Attached to shared network " + SHARED_NETWORK + ".", Purple);
+    }
+    
+    // Matrices on disk follow the numbering of the input files.  They are loaded or built that way and
+    // renumbered afterwards, so caches stay valid under any NODE_ORDER.
+    // With BUILD_MATRIX, TIMEFILE is a binary cache that is rebuilt whenever the edge file is newer.  The
+    // hierarchy backend needs no matrix and is contracted once the nodes are renumbered.
+    string timefile = time_file();
+    if (NETWORK_BACKEND == NB_HIERARCHY)
+        time_matrix.allocate(0, 0, 0);
+    else if (attached)
+        node_count = max(node_count, int(shared_segment->get_block(SHARED_TIMES).rows));
+    else if (BUILD_MATRIX && !is_fresh_cache(timefile, edgecost_file))
+    {
+        adjacency_list.resize(node_count);
+        info("Building travel time matrix from " + EDGECOST_FILE + "...", White);
+        shortestpath::build_times(adjacency_list, time_matrix, threads);
+        save_cache(time_matrix, timefile);
+    }
+    else
+        time_matrix.load(timefile);
+    adjacency_list.resize(max(node_count, time_matrix.get_rows()));
+    
+    // Distances alias the travel times unless DISTANCEFILE is given, in which case it loads on first use.
+    
+    // Next hops follow the travel times, so they are rebuilt when either input changes.
+    if (SUCCESSOR_TABLE && !attached)
+    {
+        if (NETWORK_BACKEND == NB_HIERARCHY)
+            throw runtime_error("SUCCESSOR_TABLE requires the MATRIX network backend.");
+        string successorfile = DATAROOT + "/map/" + SUCCESSORFILE;
+        if (is_fresh_cache(successorfile, edgecost_file) && is_fresh_cache(successorfile, timefile))
+            successor_matrix.load(successorfile);
+        if (successor_matrix.get_rows() != adjacency_list.size())
+        {
+            info("Building successor table from " + EDGECOST_FILE + " and " + TIMEFILE + "...", White);
+            shortestpath::build_successors(adjacency_list, time_matrix, successor_matrix, threads);
+            save_cache(successor_matrix, successorfile);
+        }
+    }
+    
+    if (NODES_FILE.size())
+        load_positions(DATAROOT + "/map/" + NODES_FILE, adjacency_list.size(), positions);
+    if (attached)
+    {
+        // The shared matrices are already renumbered; only the edge lists and positions need it.
+        SharedBlock order = shared_segment->get_block(SHARED_ORDER);
+        int const* cells = (int const*) shared_segment->get_data(SHARED_ORDER);
+        if (order.rows)
+            renumber(vector<int>(cells, cells + order.rows));
+        adopt_shared();
+    }
+    else if (NODE_ORDER == NO_HILBERT)
+    {
+        if (!positions.size())
+            throw runtime_error("NODE_ORDER HILBERT needs coordinates for every node in NODES_FILE.");
+        info("Renumbering nodes along a Hilbert curve...", White);
+        renumber(ordering::hilbert(positions));
+    }
+    else if (NODE_ORDER == NO_RCM)
+    {
+        info("Renumbering nodes by reverse Cuthill-McKee...", White);
+        renumber(ordering::reverse_cuthill_mckee(adjacency_list));
+    }
+    
+    if (NETWORK_BACKEND == NB_HIERARCHY)
+    {
+        info("Contracting road network from " + EDGECOST_FILE + "...", White);
+        vector<vector<pair<int,int>>> edges(adjacency_list.size());
+        for (auto i = 0; i < adjacency_list.size(); i++)
+            for (auto & n : adjacency_list[i])
+                edges[i].push_back(make_pair(n.target, int(n.weight)));
+        hierarchy.reset(new ContractionHierarchy(edges));
+        info("Contraction hierarchy has " + to_string(hierarchy->get_edge_count()) + " arcs.", Purple);
+        if (LANDMARKS > 0)
+        {
+            landmarks.reset(new Landmarks(edges, LANDMARKS, threads));
+            info("Selected " + to_string(landmarks->get_count()) + " landmarks for lower bounds.", Purple);
+        }
+    }
+    
+    if (RV_CANDIDATES == RV_REACH)
+    {
+        reverse_adjacency_list.resize(adjacency_list.size());
+        for (auto i = 0; i < adjacency_list.size(); i++)
+            for (auto & n : adjacency_list[i])
+                reverse_adjacency_list[n.target].push_back(neighbor(i, n.weight));
+    }
+    
+    if (TRANSPOSED_MATRIX && time_matrix.get_rows() && !transposed_matrix.get_rows())
+    {
+        transposed_matrix.allocate(time_matrix.get_cols(), time_matrix.get_rows(), 0);
+        struct transpose_thread_data transpose_data {&time_matrix, &transposed_matrix};
+        threads.auto_thread(time_matrix.get_cols(), transpose_dispatch, (void*) &transpose_data);
+    }
+    
+    // Any route is a chain of edges, so it covers at most reach_speed meters per second plus the zero time edges.
+    if (positions.size())
+    {
+        for (auto i = 0; i < adjacency_list.size(); i++)
+            for (auto & n : adjacency_list[i])
+            {
+                Point a = positions[i], b = positions[n.target];
+                double length = hypot(a.x - b.x, a.y - b.y);
+                if (n.weight > 0)
+                    reach_speed = max(reach_speed, length / n.weight);
+                else
+                    reach_margin += length;
+            }
+        info("Routes cover at most " + to_string(reach_speed) + " m/s, plus " + to_string(int(reach_margin)) +
+                " m of zero time edges.", Purple);
+    }
+    
+    // Both reach prefilters take routes over the edges, so they would miss vehicles that TIMEFILE, or a time
+    // profile faster than it, brings closer than the edges do.  The hierarchy is contracted from the edges
+    // and always agrees.
+    bool uses_reach = (RV_CANDIDATES == RV_REACH || (RV_CANDIDATES == RV_GRID && positions.size()));
+    if (uses_reach && TIME_PROFILES > 0)
+    {
+        edge_bounded = false;
+        info("Time profiles may beat " + EDGECOST_FILE + ", so R-V candidates are not narrowed by reach.", Red);
+    }
+    else if (uses_reach && time_matrix.get_rows())
+    {
+        int64_t shortcuts = count_edge_shortcuts(adjacency_list, time_matrix, threads);
+        edge_bounded = (shortcuts == 0);
+        if (!edge_bounded)
+            info(TIMEFILE + " is faster than " + EDGECOST_FILE + " for " + to_string(shortcuts) +
+                    " pairs, so R-V candidates are not narrowed by reach.", Red);
+    }
+    
+    // Time profiles are stored relative to the base matrix, at one byte per pair and profile.
+    if (TIME_PROFILES > 0 && attached)
+        profile_count = TIME_PROFILES;
+    else if (TIME_PROFILES > 0)
+    {
+        if (hierarchy)
+            throw runtime_error("Time profiles require the MATRIX network backend.");
+        if (TIME_PROFILE_PERIOD <= 0)
+            throw runtime_error("TIME_PROFILE_PERIOD must be positive.");
+        int nodes = time_matrix.get_rows();
+        profile_factors.allocate(TIME_PROFILES * nodes, nodes, 1 << PROFILE_SHIFT);
+        for (auto p = 0; p < TIME_PROFILES; p++)
+        {
+            string profilefile = TIME_PROFILE_PREFIX + to_string(p) + ".csv";
+            Matrix<time_cell_t> profile;
+            profile.load(DATAROOT + "/map/" + profilefile);
+            if (profile.get_rows() != nodes || profile.get_cols() != nodes)
+                throw runtime_error("Time profile " + profilefile + " does not match the shape of " + TIMEFILE + ".");
+            if (external_of.size())
+                profile.permute(external_of);
+            int error = quantize_profile(time_matrix, profile, profile_factors, p * nodes);
+            info("Loaded time profile " + profilefile + ", largest rounding error " + to_string(error) + " s.", White);
+        }
+        profile_count = TIME_PROFILES;
+    }
+    profile_period = TIME_PROFILE_PERIOD;
+    for (auto i = 0; i < profile_factors.get_rows(); i++)
+    {
+        profile_cell_t const* row = profile_factors.get_row(i);
+        profile_floor = min(profile_floor, int(*min_element(row, row + profile_factors.get_cols())));
+    }
+    
+    if (SHARED_NETWORK.size() && !attached)
+        publish_shared();
 }
 
-/* Travel time between nodes. */
-int Network::get_time(int node_one, int node_two) const
+/* Copy every matrix into a new shared segment and then read them from there, dropping the private copies.
+   If another process published first, keep the private copies. */
+void Network::publish_shared()
 {
-    if (node_one == -10)
-        return DWELL_PICKUP;
-    else if (node_one == -20)
-        return DWELL_ALIGHT;
-    else if (node_one == -30)
-        return 0;
-    else if (node_one < 0 || node_two < 0)
+    if (DISTANCEFILE.size())
+        call_once(distance_loaded, &Network::load_distances, this);
+    vector<SharedBlock> blocks (SHARED_BLOCKS);
+    blocks[SHARED_ORDER] = {0, external_of.size() * sizeof(int), int(external_of.size()), 1};
+    blocks[SHARED_TIMES] = describe(time_matrix);
+    blocks[SHARED_TRANSPOSED] = describe(transposed_matrix);
+    blocks[SHARED_SUCCESSORS] = describe(successor_matrix);
+    blocks[SHARED_PROFILES] = describe(profile_factors);
+    blocks[SHARED_DISTANCES] = describe(distance_matrix);
+    if (!shared_segment->create(SHARED_NETWORK, shared_signature(), blocks))
     {
-        cout << "Network Error: Line " << __LINE__ << endl;
-        getchar();
+        info("Shared network " + SHARED_NETWORK + " was created by another process, keeping a private copy.", Red);
+        shared_segment.reset();
+        return;
     }
-    return time_matrix[node_one][node_two];
+    
+    memcpy(shared_segment->get_data(SHARED_ORDER), external_of.data(), external_of.size() * sizeof(int));
+    copy_cells(time_matrix, shared_segment->get_data(SHARED_TIMES));
+    copy_cells(transposed_matrix, shared_segment->get_data(SHARED_TRANSPOSED));
+    copy_cells(successor_matrix, shared_segment->get_data(SHARED_SUCCESSORS));
+    copy_cells(profile_factors, shared_segment->get_data(SHARED_PROFILES));
+    copy_cells(distance_matrix, shared_segment->get_data(SHARED_DISTANCES));
+    shared_segment->publish();
+    adopt_shared();
+    info("Published shared network " + SHARED_NETWORK + ".", Purple);
+}
+
+void Network::adopt_shared()
+{
+    adopt(time_matrix, *shared_segment, SHARED_TIMES);
+    adopt(transposed_matrix, *shared_segment, SHARED_TRANSPOSED);
+    adopt(successor_matrix, *shared_segment, SHARED_SUCCESSORS);
+    adopt(profile_factors, *shared_segment, SHARED_PROFILES);
+    adopt(distance_matrix, *shared_segment, SHARED_DISTANCES);
+}
+
+/* Give node order[i] the id i in every structure loaded so far. */
+void Network::renumber(vector<int> const & order)
+{
+    if (order.size() != adjacency_list.size())
+        throw runtime_error("Node order does not cover every node.");
+    external_of = order;
+    internal_of.assign(order.size(), 0);
+    for (auto i = 0; i < order.size(); i++)
+        internal_of[order[i]] = i;
+    
+    vector<vector<neighbor>> renumbered(order.size());
+    for (auto i = 0; i < order.size(); i++)
+        for (auto & n : adjacency_list[order[i]])
+            renumbered[i].push_back(neighbor(internal_of[n.target], n.weight));
+    adjacency_list.swap(renumbered);
+    
+    if (positions.size())
+    {
+        vector<Point> moved(order.size());
+        for (auto i = 0; i < order.size(); i++)
+            moved[i] = positions[order[i]];
+        positions.swap(moved);
+    }
+    
+    if (time_matrix.get_rows())
+        time_matrix.permute(order);
+    if (successor_matrix.get_rows())  // Cells hold node ids too.
+    {
+        successor_matrix.permute(order);
+        node_cell_t const none = numeric_limits<node_cell_t>::max();
+        for (auto i = 0; i < successor_matrix.get_rows(); i++)
+            for (auto j = 0; j < successor_matrix.get_cols(); j++)
+                if (successor_matrix.get(i, j) != none)
+                    successor_matrix.set(i, j, internal_of[successor_matrix.get(i, j)]);
+    }
+}
+
+int Network::to_internal(int node) const
+{
+    return (internal_of.size() ? internal_of[node] : node);
+}
+
+int Network::to_external(int node) const
+{
+    return (external_of.size() ? external_of[node] : node);
+}
+
+vector<int> Network::get_path(int origin, int destination) const
+{
+    if (!successor_matrix.get_rows())
+        return (hierarchy ? hierarchy->get_path(origin, destination) : dijkstra(origin, destination));
+    
+    // The table takes the steps of dijkstra, which finishes the walks it leaves off.
+    vector<int> path {origin};
+    node_cell_t const none = numeric_limits<node_cell_t>::max();
+    for (int here = origin; here != destination;)
+    {
+        node_cell_t next = successor_matrix.get(destination, here);
+        if (next == none)
+        {
+            vector<int> rest = dijkstra(here, destination);
+            path.insert(path.end(), rest.begin() + 1, rest.end());
+            break;
+        }
+        path.push_back(next);
+        here = next;
+    }
+    return path;
+}
+
+void Network::check_nodes(int node_one, int node_two) const
+{
+    if (node_one < 0 || node_two < 0 || node_one >= adjacency_list.size() || node_two >= adjacency_list.size())
+        throw runtime_error("Travel time requested between nodes " + to_string(node_one) + " and " +
+                to_string(node_two) + " of " + to_string(adjacency_list.size()) + ".");
+}
+
+bool Network::is_bound_exact() const
+{
+    return !hierarchy && !profile_count;
+}
+
+bool Network::has_time_profiles() const
+{
+    return profile_count > 0;
+}
+
+int Network::get_dwell_time(bool is_pickup) const
+{
+    return (is_pickup ? DWELL_PICKUP : DWELL_ALIGHT);
+}
+
+void Network::get_times_to(int target, vector<int> const & sources, vector<int> & times) const
+{
+    times.resize(sources.size());
+    if (transposed_matrix.get_rows())
+    {
+        time_cell_t const* column = transposed_matrix.get_row(target);
+        for (auto i = 0; i < sources.size(); i++)
+            times[i] = column[sources[i]];
+    }
+    else
+        for (auto i = 0; i < sources.size(); i++)
+            times[i] = get_time(sources[i], target);
+}
+
+void Network::load_distances() const
+{
+    if (distance_matrix.get_rows())  // Already taken from a shared network.
+        return;
+    distance_matrix.load(DATAROOT + "/map/" + DISTANCEFILE);
+    if (external_of.size())
+        distance_matrix.permute(external_of);
 }
 
 int Network::get_distance(int node_one, int node_two) const
 {
-    return get_time(node_one, node_two);
-    if (node_one == -10 || node_one == -20 || node_one == -30)
+    if (node_one < 0)  // A vehicle dwelling or waiting at a stop covers no distance.
         return 0;
-    if (node_one < 0 || node_two < 0)
+    if (!DISTANCEFILE.size())
+        return get_time(node_one, node_two);
+    call_once(distance_loaded, &Network::load_distances, this);
+#ifndef NDEBUG
+    check_nodes(node_one, node_two);
+#endif
+    return distance_matrix.get(node_one, node_two);
+}
+
+bool Network::has_positions() const
+{
+    return positions.size() != 0;
+}
+
+Point Network::get_position(int node) const
+{
+    return positions[node];
+}
+
+double Network::get_reach(int seconds) const
+{
+    if (seconds < 0)
+        return -1;
+    return seconds * reach_speed + reach_margin;
+}
+
+bool Network::is_edge_bounded() const
+{
+    return edge_bounded;
+}
+
+int Network::get_node_count() const
+{
+    return adjacency_list.size();
+}
+
+void Network::get_reverse_reach(int destination, int limit, vector<pair<int,int>> & reached) const
+{
+    if (reverse_adjacency_list.size() != adjacency_list.size())
+        throw runtime_error("Reverse search needs RV_CANDIDATES REACH to build the reverse edges.");
+    int const unvisited = numeric_limits<int>::max();
+    static thread_local ReachScratch scratch;
+    if (scratch.time.size() != reverse_adjacency_list.size())
+        scratch.time.assign(reverse_adjacency_list.size(), unvisited);
+    if (limit < 0)
+        return;
+    
+    auto & time = scratch.time;
+    auto & heap = scratch.heap;
+    greater<pair<int,int>> later;
+    time[destination] = 0;
+    scratch.touched.push_back(destination);
+    heap.push_back(make_pair(0, destination));
+    while (heap.size())
     {
-        cout << "Negative index given to get_distance!  Network Line " << __LINE__ << endl;
-        getchar();
+        pop_heap(heap.begin(), heap.end(), later);
+        pair<int,int> top = heap.back();
+        heap.pop_back();
+        if (top.first > time[top.second])
+            continue;
+        reached.push_back(make_pair(top.second, top.first));
+        for (auto & n : reverse_adjacency_list[top.second])
+        {
+            int arrival = top.first + int(n.weight);
+            if (arrival > limit || arrival >= time[n.target])
+                continue;
+            if (time[n.target] == unvisited)
+                scratch.touched.push_back(n.target);
+            time[n.target] = arrival;
+            heap.push_back(make_pair(arrival, n.target));
+            push_heap(heap.begin(), heap.end(), later);
+        }
     }
-    return distance_matrix[node_one][node_two];
+    for (auto node : scratch.touched)
+        time[node] = unvisited;
+    scratch.touched.clear();
 }
 
 /* Specifically, this gets the distance offset. */
@@ -0,0 +1,138 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "ordering.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+
+using namespace std;
+
+namespace ordering
+{
+
+namespace
+{
+uint32_t const HILBERT_SIDE = 1 << 16;
+
+/* Distance along the Hilbert curve filling a HILBERT_SIDE square. */
+uint64_t hilbert_index(uint32_t x, uint32_t y)
+{
+    uint64_t index = 0;
+    for (uint32_t s = HILBERT_SIDE / 2; s > 0; s /= 2)
+    {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        index += uint64_t(s) * s * ((3 * rx) ^ ry);
+        if (ry == 0)  // Rotate the quadrant.
+        {
+            if (rx == 1)
+            {
+                x = HILBERT_SIDE - 1 - x;
+                y = HILBERT_SIDE - 1 - y;
+            }
+            swap(x, y);
+        }
+    }
+    return index;
+}
+}
+
+vector<int> hilbert(vector<Point> const & positions)
+{
+    if (!positions.size())
+        return vector<int>();
+    double min_x = positions[0].x, max_x = min_x, min_y = positions[0].y, max_y = min_y;
+    for (auto & p : positions)
+    {
+        min_x = min(min_x, p.x);
+        max_x = max(max_x, p.x);
+        min_y = min(min_y, p.y);
+        max_y = max(max_y, p.y);
+    }
+    double scale = (HILBERT_SIDE - 1) / max(max(max_x - min_x, max_y - min_y), 1e-9);
+    
+    vector<pair<uint64_t,int>> keyed(positions.size());
+    for (auto i = 0; i < positions.size(); i++)
+        keyed[i] = make_pair(hilbert_index(uint32_t((positions[i].x - min_x) * scale),
+                uint32_t((positions[i].y - min_y) * scale)), i);
+    sort(keyed.begin(), keyed.end());
+    
+    vector<int> order(positions.size());
+    for (auto i = 0; i < keyed.size(); i++)
+        order[i] = keyed[i].second;
+    return order;
+}
+
+vector<int> reverse_cuthill_mckee(vector<vector<neighbor>> const & adjacency_list)
+{
+    int node_count = adjacency_list.size();
+    vector<vector<int>> undirected(node_count);
+    for (auto i = 0; i < node_count; i++)
+        for (auto & n : adjacency_list[i])
+            if (n.target != i)
+            {
+                undirected[i].push_back(n.target);
+                undirected[n.target].push_back(i);
+            }
+    for (auto & list : undirected)
+    {
+        sort(list.begin(), list.end());
+        list.erase(unique(list.begin(), list.end()), list.end());
+    }
+    auto by_degree = [&undirected](int a, int b) -> bool
+    {
+        return make_pair(undirected[a].size(), a) < make_pair(undirected[b].size(), b);
+    };
+    for (auto & list : undirected)
+        sort(list.begin(), list.end(), by_degree);
+    
+    // Breadth first from a lowest degree node of each component, visiting neighbours by degree.
+    vector<int> starts(node_count);
+    iota(starts.begin(), starts.end(), 0);
+    sort(starts.begin(), starts.end(), by_degree);
+    vector<bool> visited(node_count, false);
+    vector<int> order;
+    order.reserve(node_count);
+    for (auto start : starts)
+    {
+        if (visited[start])
+            continue;
+        visited[start] = true;
+        order.push_back(start);
+        for (auto head = order.size() - 1; head < order.size(); head++)
+            for (auto next : undirected[order[head]])
+                if (!visited[next])
+                {
+                    visited[next] = true;
+                    order.push_back(next);
+                }
+    }
+    reverse(order.begin(), order.end());
+    return order;
+}
+
+}
@@ -114,20 +114,27 @@ map<Vehicle*,Trip> rebalance_matching_lp(
 map<Vehicle*, vector<Trip>> make_rebalance_trips(vector<Vehicle*> & unassigned_vehicles, 
         vector<Request*> & unassigned_requests, Network const & network)
 {
-    map<Vehicle*, vector<Trip>> trip_list;
+    // Fill the cost table one request at a time, reading the times into each origin in a batch.
+    vector<int> sources, times;
     for (Vehicle* v : unassigned_vehicles)
+        sources.push_back(v->node);
+    vector<vector<Trip>> trips (unassigned_vehicles.size());
+    for (Request* r : unassigned_requests)
     {
-        vector<Trip> trips;
-        for (Request* r : unassigned_requests)
+        network.get_times_to(r->origin, sources, times);
+        for (auto i = 0; i < unassigned_vehicles.size(); i++)
         {
             Trip t {};
             t.is_fake = true;
             t.requests.push_back(r);
-            t.cost = network.get_vehicle_time(*v, r->origin);
-            trips.push_back(t);
+            t.cost = unassigned_vehicles[i]->offset + times[i];
+            trips[i].push_back(t);
         }
-        trip_list[v] = trips;
     }
+    
+    map<Vehicle*, vector<Trip>> trip_list;
+    for (auto i = 0; i < unassigned_vehicles.size(); i++)
+        trip_list[unassigned_vehicles[i]] = trips[i];
     return trip_list;
 }
 
@@ -0,0 +1,63 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "routecache.hpp"
+
+using namespace std;
+
+size_t RouteCache::KeyHash::operator()(Key const & key) const
+{
+    uint64_t hash = 14695981039346656037ull;  // FNV-1a over the words.
+    for (auto word : key)
+        hash = (hash ^ word) * 1099511628211ull;
+    return hash ^ (hash >> 32);
+}
+
+bool RouteCache::find(Key const & key, Route & route)
+{
+    Shard & shard = shards[KeyHash()(key) % SHARDS];
+    lock_guard<mutex> guard (shard.lock);
+    auto found = shard.routes.find(key);
+    if (found == shard.routes.end())
+        return false;
+    route = found->second;
+    return true;
+}
+
+void RouteCache::insert(Key const & key, Route const & route)
+{
+    Shard & shard = shards[KeyHash()(key) % SHARDS];
+    lock_guard<mutex> guard (shard.lock);
+    shard.routes.insert(make_pair(key, route));
+}
+
+void RouteCache::clear()
+{
+    for (auto & shard : shards)
+    {
+        lock_guard<mutex> guard (shard.lock);
+        shard.routes.clear();
+    }
+}
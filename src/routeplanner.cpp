@@ -23,15 +23,18 @@
  */
 
 #include "../headers/formatting.hpp"
+#include "../headers/routecache.hpp"
 #include "../headers/routeplanner.hpp"
 #include "../headers/settings.hpp"
 
 #include <algorithm>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
-#include <map>
+#include <limits>
 #include <math.h>
 #include <mutex>
+#include <random>
 #include <set>
 
 
@@ -46,6 +49,7 @@ struct MetaNodeStop
 {
     NodeStop* node;
     vector<MetaNodeStop*> unlocks;
+    int index;              // Bit of the stop in the bitmask search.
     
     friend bool operator<(MetaNodeStop const & a, MetaNodeStop const & b)
     {
@@ -72,14 +76,14 @@ struct MnsSort
     }
 };
 
-pair<int,vector<NodeStop>> format_path(pair<int,vector<NodeStop*>> const & reverse_path, int time)
+pair<int,vector<NodeStop>> format_path(int cost, vector<NodeStop*> const & reverse_path, int time)
 {
-    int cost = reverse_path.first;
     if (CTSP_OBJECTIVE == CTSP_VMT && cost >= 0) // Use this with VMT objective only.
         cost -= time;
     vector<NodeStop> ordered_rs;
-    for (auto i = reverse_path.second.size(); i--;)
-        ordered_rs.push_back(*reverse_path.second[i]);
+    ordered_rs.reserve(reverse_path.size());
+    for (auto i = reverse_path.size(); i--;)
+        ordered_rs.push_back(*reverse_path[i]);
     
     // Format the response.
     return make_pair(cost, ordered_rs);
@@ -92,36 +96,120 @@ int get_alight_deadline(Request const * r)
 
 enum Action {PICKUP, DROPOFF, NO_ACTION};
 
+int const DEADLINE_CHECK_INTERVAL = 64;  // Expansions between reads of the clock under RTV_TIMELIMIT.
+
+/* Deadline policies of the route search.  The search asks expired() before each expansion and, once it says
+   yes, unwinds keeping the best route found so far.  found() is told of every complete route.  NoDeadline
+   compiles away. */
+struct NoDeadline
+{
+    bool expired()
+    {
+        return false;
+    }
+    void found() {}
+};
+
+/* Stops at the first complete route, for feasibility checks. */
+struct FirstRoute
+{
+    bool done;
+    
+    FirstRoute() : done(false) {}
+    
+    bool expired()
+    {
+        return done;
+    }
+    void found()
+    {
+        done = true;
+    }
+};
+
+/* Reads the clock every interval calls, against RTV_TIMELIMIT. */
+struct ClockDeadline
+{
+    chrono::steady_clock::time_point start;
+    int interval;
+    int countdown;
+    bool passed;
+    
+    ClockDeadline(chrono::steady_clock::time_point t, int interval = DEADLINE_CHECK_INTERVAL) : start(t),
+            interval(interval), countdown(0), passed(false) {}
+    
+    bool expired()
+    {
+        if (passed || --countdown > 0)
+            return passed;
+        countdown = interval;
+        auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+        passed = (duration > RTV_TIMELIMIT);
+        return passed;
+    }
+    void found() {}
+};
+
+/* Stops at the first complete route or when deadline does, whichever comes first. */
+template <typename Deadline>
+struct FirstRouteWithin
+{
+    Deadline & deadline;
+    bool done;
+    
+    FirstRouteWithin(Deadline & deadline) : deadline(deadline), done(false) {}
+    
+    bool expired()
+    {
+        return done || deadline.expired();
+    }
+    void found()
+    {
+        done = true;
+        deadline.found();
+    }
+};
+
+template <typename Deadline>
 pair<int,vector<NodeStop*>> recursive_search(int initial_location, int residual_capacity,
         set<MetaNodeStop*,MnsSort> const & initially_available, Network const & network, int time, int best_time,
-        Action prev_action)
+        Action prev_action, Deadline & deadline)
 {
     // If there is no new available stop to add...
     if (!initially_available.size())
+    {
+        deadline.found();
         return make_pair(time, vector<NodeStop*>()); // VMT objective
+    }
     
     // Iterate through the possible next NodeStops to visit.
     vector<NodeStop*> best_tail;
     MetaNodeStop* previous = NULL;
     for (MetaNodeStop* m : initially_available)
     {
+        if (deadline.expired())
+            break;
+        
         // Select the node.  Strict order on alightings.
         if (previous != NULL && !m->node->is_pickup && previous->node->node == m->node->node)
             continue;
         previous = m;
         
-        // Compute time of visit.
         int new_location = m->node->node;
-        int arrival_time = time + network.get_time(initial_location, new_location);
-        if (m->node->is_pickup)
-            if (m->node->r->entry_time > arrival_time)
-                arrival_time = m->node->r->entry_time;
         
         // Account for rule about batched boarding/alighting.  Must match simulator behavior.
+        int dwell = 0;
         if (prev_action == DROPOFF && (m->node->is_pickup || initial_location != new_location))
-            arrival_time += DWELL_ALIGHT;
+            dwell = DWELL_ALIGHT;
         else if (prev_action == PICKUP && (!m->node->is_pickup || initial_location != new_location))
-            arrival_time += DWELL_PICKUP;
+            dwell = DWELL_PICKUP;
+        
+        // Compute time of visit, departing once the dwell is over as the simulator does.
+        int arrival_time = time + network.get_time(initial_location, new_location, time + dwell);
+        if (m->node->is_pickup)
+            if (m->node->r->entry_time > arrival_time)
+                arrival_time = m->node->r->entry_time;
+        arrival_time += dwell;
         if (m->node->is_pickup && m->node->r->entry_time > arrival_time)
             arrival_time = m->node->r->entry_time;
         
@@ -153,25 +241,35 @@ pair<int,vector<NodeStop*>> recursive_search(int initial_location, int residual_
             for (auto newnode : m->unlocks)
                 remaining_nodes.insert(newnode);
         
-        // Basic check: can subsequent nodes be served?
+        // Basic check: can subsequent nodes be served?  Without time profiles each reaching time, plus the
+        // ride of a pickup not yet made, also bounds when the route can end.
         bool basic_reachability = true;
+        bool bound_finish = (best_time != -1 && !network.has_time_profiles());
+        int finish = arrival_time;
         for (auto x : remaining_nodes)
         {
-            int reaching_time = arrival_time + network.get_time(new_location, x->node->node);
+            int reaching_time = arrival_time + network.get_reach_time(new_location, x->node->node);
             if ((x->node->is_pickup && reaching_time > x->node->r->latest_boarding) ||
                     (!x->node->is_pickup && reaching_time > x->node->r->latest_alighting))
             {
                 basic_reachability = false;
                 break;
             }
+            if (bound_finish && x->node->is_pickup)
+                finish = max(finish, max(reaching_time, x->node->r->entry_time) +
+                        network.get_lower_bound(x->node->node, x->node->r->destination));
+            else if (bound_finish)
+                finish = max(finish, reaching_time);
         }
         if (!basic_reachability)
             continue;
+        if (bound_finish && finish >= best_time)
+            continue;
         
         // Recursive call to get cost, partial reverse path of tail.
         Action this_action = (m->node->is_pickup ? PICKUP : DROPOFF);
         pair<int,vector<NodeStop*>> tail = recursive_search(new_location, new_residual_capacity,
-                remaining_nodes, network, arrival_time, best_time, this_action);
+                remaining_nodes, network, arrival_time, best_time, this_action, deadline);
         
         // If this is the best we have seen so far, update!
         if (tail.first == -1)
@@ -187,11 +285,539 @@ pair<int,vector<NodeStop*>> recursive_search(int initial_location, int residual_
     return make_pair(best_time, best_tail);
 }
 
-pair<int,vector<NodeStop*>> recursive_search(int initial_location, int residual_capacity,
-        set<MetaNodeStop*> const & initially_available, Network const & network, int time, int best_time)
+int const KERNEL_STOPS = 64;  // Most stops the bitmask search takes, one bit each.
+
+/* Stop of the bitmask search, with the request fields the search reads copied alongside. */
+struct KernelStop
+{
+    NodeStop* node;
+    int location;
+    bool is_pickup;
+    int entry_time;
+    int deadline;           // Latest arrival: the alighting deadline, and for pickups the waiting limit too.
+    int latest_reach;       // Latest boarding or alighting, for the reachability check.
+    int ride_bound;         // Lower bound from a pickup to its destination.
+    uint64_t unlocks;
+    int rank;               // Position by latest_reach, see rank_deadlines.
+    uint64_t ranked_unlocks;
+};
+
+/* Everything the bitmask search keeps across levels.  Stops are indexed in MnsSort order, so visiting the
+   bits of a mask from the lowest up follows the iteration order of the set-based search. */
+struct KernelState
+{
+    Network const* network;
+    KernelStop stops[KERNEL_STOPS];
+    int best_time;
+    bool bound_finish;      // Reaching times bound the finish, which time profiles do not allow.
+    NodeStop* path[KERNEL_STOPS];
+    NodeStop* best_path[KERNEL_STOPS];
+    int best_length;
+    int path_index[KERNEL_STOPS];   // Stop indices of path, to order routes of equal cost.
+    int best_index[KERNEL_STOPS];
+    int found;                  // Routes taken as the incumbent so far.
+    int by_rank[KERNEL_STOPS];  // Stop index of each rank.
+};
+
+/* How a partial route compares in stop index order with the start of the incumbent: earlier, the same or
+   later.  Among routes of equal cost the search keeps the earliest, which is the one the depth first search
+   in MnsSort order would have found first, so ordering children by bound never changes the route. */
+enum PathOrder {EARLIER, SAME, LATER};
+
+/* Order of the path so far, of order relation, extended by stop index at depth. */
+PathOrder extend_order(KernelState const & s, PathOrder relation, int depth, int index)
+{
+    if (!s.best_length)
+        return LATER;  // No incumbent route, only a bound, so only faster routes count.
+    if (relation != SAME)
+        return relation;
+    if (index == s.best_index[depth])
+        return SAME;
+    return (index < s.best_index[depth] ? EARLIER : LATER);
+}
+
+/* Whether a route through a stop of order relation that finishes no sooner than finish can still win. */
+bool can_win(KernelState const & s, PathOrder relation, int finish)
+{
+    return (s.best_time == -1 || finish < s.best_time || (finish == s.best_time && relation != LATER));
+}
+
+/* The same stops as a mask over ranks. */
+uint64_t to_ranks(KernelState const & s, uint64_t set)
+{
+    uint64_t ranks = 0;
+    for (; set; set &= set - 1)
+        ranks |= uint64_t(1) << s.stops[__builtin_ctzll(set)].rank;
+    return ranks;
+}
+
+/* Ranks the first count stops by latest_reach, earliest first.  The search carries the stops left as a mask
+   over ranks too, kept up to date through ranked_unlocks, so the lowest bit is the tightest deadline. */
+void rank_deadlines(KernelState & s, int count)
+{
+    for (auto i = 0; i < count; i++)
+        s.by_rank[i] = i;
+    sort(s.by_rank, s.by_rank + count, [&](int a, int b) {
+            return (s.stops[a].latest_reach < s.stops[b].latest_reach ||
+                    (s.stops[a].latest_reach == s.stops[b].latest_reach && a < b)); });
+    for (auto i = 0; i < count; i++)
+        s.stops[s.by_rank[i]].rank = i;
+    for (auto i = 0; i < count; i++)
+        s.stops[i].ranked_unlocks = to_ranks(s, s.stops[i].unlocks);
+}
+
+/* Weight of a minimum spanning tree over location and the stops in set, each edge weighing the smaller lower
+   bound of its two directions.  A route from location through every stop spans them all, so it spends at
+   least this long travelling. */
+int spanning_bound(KernelState const & s, int location, uint64_t set)
+{
+    int nodes[KERNEL_STOPS];
+    int distance[KERNEL_STOPS];
+    int count = 0;
+    for (; set; set &= set - 1)
+    {
+        nodes[count] = s.stops[__builtin_ctzll(set)].location;
+        distance[count++] = numeric_limits<int>::max();
+    }
+    
+    // Prim's algorithm, growing the tree from location.
+    int total = 0;
+    int added = location;
+    while (count)
+    {
+        int closest = 0;
+        for (auto i = 0; i < count; i++)
+        {
+            distance[i] = min(distance[i], min(s.network->get_lower_bound(added, nodes[i]),
+                    s.network->get_lower_bound(nodes[i], added)));
+            if (distance[i] < distance[closest])
+                closest = i;
+        }
+        total += distance[closest];
+        added = nodes[closest];
+        count--;
+        nodes[closest] = nodes[count];
+        distance[closest] = distance[count];
+    }
+    return total;
+}
+
+/* Next stop of the bitmask search that passed the checks, with the lower bound on the finish through it. */
+struct KernelChild
+{
+    int index;
+    int arrival_time;
+    int residual_capacity;
+    int bound;
+    uint64_t remaining;
+    uint64_t ranked_remaining;
+};
+
+/* Same search as recursive_search, with the available stops as a bitmask and the incumbent route kept in
+   the state instead of being returned up the stack.  Nothing is allocated per expanded node.  Unvisited
+   holds the stops not yet on the path, locked or not, and ranked_available the available ones by rank.  The
+   next stops are checked first and then expanded from the lowest bound on the finish up, so good routes are
+   found early and prune the rest.  Relation places the path so far against the incumbent, see PathOrder. */
+template <typename Deadline>
+void kernel_search(KernelState & s, int initial_location, int residual_capacity, uint64_t available,
+        uint64_t ranked_available, uint64_t unvisited, int time, Action prev_action, int depth,
+        PathOrder relation, Deadline & deadline)
+{
+    // A complete route.  The pruning below means it beats the incumbent, or ties it from earlier in order.
+    if (!available)
+    {
+        deadline.found();
+        s.best_time = time;
+        copy(s.path, s.path + depth, s.best_path);
+        copy(s.path_index, s.path_index + depth, s.best_index);
+        s.best_length = depth;
+        s.found++;
+        return;
+    }
+    
+    KernelChild children[KERNEL_STOPS];
+    int child_count = 0;
+    int previous = -1;
+    for (uint64_t left = available; left; left &= left - 1)
+    {
+        int index = __builtin_ctzll(left);
+        KernelStop const & m = s.stops[index];
+        
+        // Select the node.  Strict order on alightings.
+        if (previous != -1 && !m.is_pickup && s.stops[previous].location == m.location)
+            continue;
+        previous = index;
+        
+        // Account for rule about batched boarding/alighting.  Must match simulator behavior.
+        int dwell = 0;
+        if (prev_action == DROPOFF && (m.is_pickup || initial_location != m.location))
+            dwell = DWELL_ALIGHT;
+        else if (prev_action == PICKUP && (!m.is_pickup || initial_location != m.location))
+            dwell = DWELL_PICKUP;
+        
+        int arrival_time = time + s.network->get_time(initial_location, m.location, time + dwell);
+        if (m.is_pickup && m.entry_time > arrival_time)
+            arrival_time = m.entry_time;
+        arrival_time += dwell;
+        if (m.is_pickup && m.entry_time > arrival_time)
+            arrival_time = m.entry_time;
+        
+        PathOrder order = extend_order(s, relation, depth, index);
+        if (!can_win(s, order, arrival_time))
+            continue;
+        int new_residual_capacity = residual_capacity + (m.is_pickup ? -1 : 1);
+        if (new_residual_capacity < 0 || arrival_time > m.deadline)
+            continue;
+        
+        // Can subsequent nodes be served, and when can the route end at the earliest?  Each reaching time,
+        // plus the ride of a pickup not yet made, bounds the finish.  Time profiles round per leg, so there
+        // the bound only orders the next stops.  Stops are scanned from the tightest deadline, which alone
+        // rules out most dead ends without a lookup.
+        uint64_t remaining = (available & ~(uint64_t(1) << index)) | m.unlocks;
+        uint64_t ranked_remaining = (ranked_available & ~(uint64_t(1) << m.rank)) | m.ranked_unlocks;
+        if (ranked_remaining && arrival_time > s.stops[s.by_rank[__builtin_ctzll(ranked_remaining)]].latest_reach)
+            continue;
+        bool bound_finish = (s.best_time != -1 && s.bound_finish);
+        bool basic_reachability = true;
+        int finish = arrival_time;
+        for (uint64_t rest = ranked_remaining; rest; rest &= rest - 1)
+        {
+            KernelStop const & x = s.stops[s.by_rank[__builtin_ctzll(rest)]];
+            int reaching_time = arrival_time + s.network->get_reach_time(m.location, x.location);
+            if (reaching_time > x.latest_reach)
+            {
+                basic_reachability = false;
+                break;
+            }
+            if (x.is_pickup)
+                finish = max(finish, max(reaching_time, x.entry_time) + x.ride_bound);
+            else
+                finish = max(finish, reaching_time);
+        }
+        if (!basic_reachability || (bound_finish && !can_win(s, order, finish)))
+            continue;
+        
+        // Every stop left must still be visited, so the rest of the route spans them.  Only worth the
+        // quadratic cost once there is an incumbent to prune against.
+        if (bound_finish)
+        {
+            uint64_t left_over = unvisited & ~(uint64_t(1) << index);
+            finish = max(finish, arrival_time + spanning_bound(s, m.location, left_over));
+            if (!can_win(s, order, finish))
+                continue;
+        }
+        children[child_count++] = {index, arrival_time, new_residual_capacity, finish, remaining, ranked_remaining};
+    }
+    
+    // Ties keep the MnsSort order of the stops.
+    sort(children, children + child_count, [](KernelChild const & a, KernelChild const & b) {
+            return (a.bound < b.bound || (a.bound == b.bound && a.index < b.index)); });
+    int found = s.found;
+    for (auto i = 0; i < child_count; i++)
+    {
+        if (deadline.expired())
+            break;
+        KernelChild const & c = children[i];
+        KernelStop const & m = s.stops[c.index];
+        
+        // A route found below here starts with the path so far.
+        if (s.found != found)
+            relation = SAME;
+        
+        // The incumbent may have improved since the checks.  Later children bound no lower.
+        PathOrder order = extend_order(s, relation, depth, c.index);
+        if (s.best_time != -1 && s.bound_finish && c.bound > s.best_time)
+            break;
+        if ((s.bound_finish && !can_win(s, order, c.bound)) || !can_win(s, order, c.arrival_time))
+            continue;
+        
+        s.path[depth] = m.node;
+        s.path_index[depth] = c.index;
+        kernel_search(s, m.location, c.residual_capacity, c.remaining, c.ranked_remaining,
+                unvisited & ~(uint64_t(1) << c.index), c.arrival_time, (m.is_pickup ? PICKUP : DROPOFF), depth + 1,
+                order, deadline);
+    }
+}
+
+/* Most stops the dynamic program takes.  Up to 2^n n states are kept for n stops, so about a million at 16,
+   and larger instances go to the branch and bound, which a deadline can cut short. */
+int const DP_STOPS = 16;
+
+/* State of the dynamic program: the stops visited, the last of them, and the earliest time to get there. */
+struct DpState
+{
+    uint64_t visited;
+    uint64_t available;
+    int last;               // DP_STOPS for the vehicle's starting point.
+    int time;
+    int parent;             // Index into the previous layer.
+    
+    uint64_t key() const
+    {
+        return (visited << 6) | last;
+    }
+};
+
+/* Open addressing index of the states of one layer by key.  Slots hold positions in the layer, -1 if empty.
+   It grows by rebuilding from the layer, and clearing keeps the slots for the next layer. */
+struct DpIndex
+{
+    vector<int> slots;
+    
+    void clear(size_t states)
+    {
+        size_t size = 16;
+        while (size < 2 * states)
+            size *= 2;
+        slots.assign(size, -1);
+    }
+    
+    int & find(uint64_t key, vector<DpState> const & layer)
+    {
+        size_t mask = slots.size() - 1;
+        size_t i = (key * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+        while (slots[i] != -1 && layer[slots[i]].key() != key)
+            i = (i + 1) & mask;
+        return slots[i];
+    }
+    
+    void grow(vector<DpState> const & layer)
+    {
+        clear(2 * layer.size());
+        for (auto p = 0; p < layer.size(); p++)
+            find(layer[p].key(), layer) = p;
+    }
+};
+
+/* Buffers the route searches of a thread reuse from one call to the next, so that once they have grown to
+   the largest instance seen, a search allocates nothing but the route it returns.  Meta nodes keep the
+   capacity of their unlock lists too.  Only the set-based search, past KERNEL_STOPS stops, still allocates. */
+struct Scratch
+{
+    vector<NodeStop> nodes;
+    vector<MetaNodeStop> meta_nodes;
+    vector<MetaNodeStop*> available;        // Stops free of precedence at the start.
+    vector<MetaNodeStop*> all_stops;
+    vector<MetaNodeStop*> previous_order;   // For FIX_PREFIX.
+    vector<MetaNodeStop*> captured;
+    vector<NodeStop*> path;                 // Reverse path of the last search.
+    vector<vector<DpState>> layers;
+    DpIndex dp_index;
+    vector<int> service;                    // For insertion.
+    vector<int> absorbed;
+    vector<int> tolerance;
+    vector<int> load;
+    vector<NodeStop> candidate;
+    vector<NodeStop> best_order;
+    vector<Request*> sorted;                // For travel.
+    RouteCache::Key key;
+    vector<NodeStop> order;                 // For lns_travel.
+    vector<NodeStop> moved;
+    vector<Request*> riders;
+};
+
+thread_local Scratch scratch;
+
+/* Readies the first count scratch nodes and meta nodes, each meta node on its own node and unlocking nothing.
+   Pointers to them hold until the next call. */
+void prepare_stops(int count)
 {
-    set<MetaNodeStop*,MnsSort> update (initially_available.begin(), initially_available.end());
-    return recursive_search(initial_location, residual_capacity, update, network, time, best_time, NO_ACTION);
+    if (scratch.nodes.size() < count)
+    {
+        scratch.nodes.resize(count);
+        scratch.meta_nodes.resize(count);
+    }
+    for (auto i = 0; i < count; i++)
+    {
+        scratch.meta_nodes[i].node = &scratch.nodes[i];
+        scratch.meta_nodes[i].unlocks.clear();
+    }
+    scratch.available.clear();
+}
+
+/* Exact search by dynamic programming over (visited stops, last stop) for CTSP FULL_DP.  The load follows
+   from the visited stops, and since a later start never finishes sooner without time profiles, only the
+   earliest arrival at each state is kept.  Layer k holds the states with k stops visited.  Transitions make the same checks as the
+   branch and bound, so the cost matches it, though ties between equally fast orders may break differently.
+   The reverse path goes to scratch.path.  No route is complete before the last layer, so if the deadline
+   passes first there is none to give and the result is -1, as from a branch and bound cut short early. */
+template <typename Deadline>
+int dp_search(KernelState const & s, int stop_count, int initial_location, int residual_capacity,
+        uint64_t available, int time, Deadline & deadline)
+{
+    uint64_t pickups = 0;
+    for (auto i = 0; i < stop_count; i++)
+        if (s.stops[i].is_pickup)
+            pickups |= uint64_t(1) << i;
+    
+    vector<vector<DpState>> & layers = scratch.layers;
+    DpIndex & index_of = scratch.dp_index;
+    if (layers.size() < stop_count + 1)
+        layers.resize(stop_count + 1);
+    layers[0].assign(1, DpState {0, available, DP_STOPS, time, -1});
+    auto k = 0;
+    for (; k < stop_count && layers[k].size(); k++)
+    {
+        vector<DpState> & next = layers[k + 1];
+        next.clear();
+        index_of.clear(layers[k].size());
+        for (auto p = 0; p < layers[k].size(); p++)
+        {
+            if (deadline.expired())
+            {
+                scratch.path.clear();
+                return -1;
+            }
+            DpState const & state = layers[k][p];
+            int location = initial_location;
+            Action prev_action = NO_ACTION;
+            if (state.last != DP_STOPS)
+            {
+                location = s.stops[state.last].location;
+                prev_action = (s.stops[state.last].is_pickup ? PICKUP : DROPOFF);
+            }
+            int load = __builtin_popcountll(state.visited & pickups) - __builtin_popcountll(state.visited & ~pickups);
+            
+            for (uint64_t left = state.available; left; left &= left - 1)
+            {
+                int index = __builtin_ctzll(left);
+                KernelStop const & m = s.stops[index];
+                
+                int dwell = 0;
+                if (prev_action == DROPOFF && (m.is_pickup || location != m.location))
+                    dwell = DWELL_ALIGHT;
+                else if (prev_action == PICKUP && (!m.is_pickup || location != m.location))
+                    dwell = DWELL_PICKUP;
+                
+                int arrival_time = state.time + s.network->get_time(location, m.location, state.time + dwell);
+                if (m.is_pickup && m.entry_time > arrival_time)
+                    arrival_time = m.entry_time;
+                arrival_time += dwell;
+                if (m.is_pickup && m.entry_time > arrival_time)
+                    arrival_time = m.entry_time;
+                
+                if (residual_capacity - load - (m.is_pickup ? 1 : 0) < 0 || arrival_time > m.deadline)
+                    continue;
+                
+                // Keep only the earliest arrival per state, before the more costly reachability check.
+                uint64_t visited = state.visited | (uint64_t(1) << index);
+                uint64_t key = (visited << 6) | index;
+                int found = index_of.find(key, next);
+                if (found != -1 && next[found].time <= arrival_time)
+                    continue;
+                
+                uint64_t remaining = (state.available & ~(uint64_t(1) << index)) | m.unlocks;
+                bool basic_reachability = true;
+                        for (uint64_t rest = remaining; rest; rest &= rest - 1)
+                {
+                    KernelStop const & x = s.stops[__builtin_ctzll(rest)];
+                    if (arrival_time + s.network->get_reach_time(m.location, x.location) > x.latest_reach)
+                    {
+                        basic_reachability = false;
+                        break;
+                    }
+                }
+                if (!basic_reachability)
+                    continue;
+                
+                if (found != -1)
+                    next[found] = {visited, remaining, index, arrival_time, p};
+                else
+                {
+                    next.push_back({visited, remaining, index, arrival_time, p});
+                    if (2 * next.size() > index_of.slots.size())
+                        index_of.grow(next);
+                    else
+                        index_of.find(key, next) = next.size() - 1;
+                }
+            }
+        }
+    }
+    
+    // The earliest complete route, traced back through the layers.  Reverse path, as recursive_search gives.
+    scratch.path.clear();
+    if (k != stop_count || !layers[k].size())
+        return -1;
+    int best = 0;
+    for (auto p = 1; p < layers[k].size(); p++)
+        if (layers[k][p].time < layers[k][best].time)
+            best = p;
+    int best_time = layers[k][best].time;
+    deadline.found();
+    for (; k > 0; k--)
+    {
+        scratch.path.push_back(s.stops[layers[k][best].last].node);
+        best = layers[k][best].parent;
+    }
+    return best_time;
+}
+
+/* Searches the first stop_count scratch meta nodes, starting from those in initially_available, for a route
+   finishing before best_time (if not -1).  Returns the finishing time, or -1, and leaves the reverse path in
+   scratch.path.  The dynamic program ignores best_time.  Small instances, which is nearly all of
+   them, go to the bitmask search. */
+template <typename Deadline>
+int recursive_search(int initial_location, int residual_capacity, vector<MetaNodeStop*> const & initially_available,
+        int stop_count, Network const & network, int time, int best_time, Deadline & deadline)
+{
+    if (stop_count > KERNEL_STOPS)
+    {
+        set<MetaNodeStop*,MnsSort> update (initially_available.begin(), initially_available.end());
+        pair<int,vector<NodeStop*>> result = recursive_search(initial_location, residual_capacity, update,
+                network, time, best_time, NO_ACTION, deadline);
+        scratch.path = result.second;
+        return (result.first == best_time ? -1 : result.first);
+    }
+    
+    vector<MetaNodeStop*> & all_stops = scratch.all_stops;
+    all_stops.clear();
+    for (auto i = 0; i < stop_count; i++)
+        all_stops.push_back(&scratch.meta_nodes[i]);
+    sort(all_stops.begin(), all_stops.end(), MnsSort());
+    for (auto i = 0; i < stop_count; i++)
+        all_stops[i]->index = i;
+    
+    KernelState s;
+    s.network = &network;
+    s.best_time = best_time;
+    s.bound_finish = !network.has_time_profiles();
+    s.best_length = 0;
+    s.found = 0;
+    uint64_t available = 0;
+    for (auto m : all_stops)
+    {
+        Request const* r = m->node->r;
+        KernelStop & k = s.stops[m->index];
+        k.node = m->node;
+        k.location = m->node->node;
+        k.is_pickup = m->node->is_pickup;
+        k.entry_time = r->entry_time;
+        k.deadline = get_alight_deadline(r);
+        if (k.is_pickup)
+            k.deadline = min(k.deadline, r->entry_time + MAX_WAITING);
+        k.latest_reach = (k.is_pickup ? r->latest_boarding : r->latest_alighting);
+        k.ride_bound = (k.is_pickup ? network.get_lower_bound(k.location, r->destination) : 0);
+        k.unlocks = 0;
+        for (auto u : m->unlocks)
+            k.unlocks |= uint64_t(1) << u->index;
+    }
+    for (auto m : initially_available)
+        available |= uint64_t(1) << m->index;
+    
+    // Under time profiles leaving later can arrive sooner, so keeping only the earliest arrival at each state
+    // could lose the best route.  The branch and bound keeps it, as it only prunes on the actual arrivals and
+    // looks ahead by lower bounds (Network::get_reach_time).
+    if (CTSP == FULL_DP && stop_count <= DP_STOPS && !network.has_time_profiles())
+        return dp_search(s, stop_count, initial_location, residual_capacity, available, time, deadline);
+    uint64_t unvisited = (stop_count == KERNEL_STOPS ? ~uint64_t(0) : (uint64_t(1) << stop_count) - 1);
+    rank_deadlines(s, stop_count);
+    kernel_search(s, initial_location, residual_capacity, available, to_ranks(s, available), unvisited, time,
+            NO_ACTION, 0, SAME, deadline);
+    
+    // Reverse path, as recursive_search returns it.
+    scratch.path.assign(reverse_iterator<NodeStop**>(s.best_path + s.best_length),
+            reverse_iterator<NodeStop**>(s.best_path));
+    return (s.best_time == best_time ? -1 : s.best_time);
 }
 
 pair<int,vector<NodeStop>> rebalance(Vehicle const & v, vector<Request*> const & rs, Network const & network)
@@ -208,362 +834,535 @@ pair<int,vector<NodeStop>> rebalance(Vehicle const & v, vector<Request*> const &
     return make_pair(cost, nodes);
 }
 
+/* Bound is a finishing time the route must beat, -1 for none. */
+template <typename Deadline>
 pair<int,vector<NodeStop>> new_travel(Vehicle const & v, vector<Request*> const & rs,
-        Network const & network, int time)
+        Network const & network, int time, Deadline & deadline, int bound = -1)
 {
-    // Convert onboard passengers and new ones into NodeStops and MetaNodeStops.
-    vector<NodeStop> nodes;                                 // Wrapper for locations.
-    vector<MetaNodeStop> meta_nodes;                        // Object that store precedence.
-    set<MetaNodeStop*> initially_available;                 // Place you can visit without precedence.
-    nodes.reserve(2 * rs.size() + v.passengers.size());
-    meta_nodes.reserve(2 * rs.size() + v.passengers.size());
-    
+    // Convert onboard passengers and new ones into NodeStops and MetaNodeStops.  MetaNodeStops store the
+    // precedence, and the available list holds the stops you can visit without it.
+    prepare_stops(2 * rs.size() + v.passengers.size());
+    vector<NodeStop> & nodes = scratch.nodes;
+    vector<MetaNodeStop> & meta_nodes = scratch.meta_nodes;
+    vector<MetaNodeStop*> & initially_available = scratch.available;
+    int count = 0;
     for (auto r : rs)
     {
-        nodes.push_back({r, true, r->origin});
-        nodes.push_back({r, false, r->destination});
-        meta_nodes.push_back({&nodes[nodes.size() - 1], vector<MetaNodeStop*>()});
-        meta_nodes.push_back({&nodes[nodes.size() - 2], 
-                vector<MetaNodeStop*>{&meta_nodes[meta_nodes.size() - 1]}});
-        initially_available.insert(&meta_nodes[meta_nodes.size() - 1]);
+        nodes[count] = {r, true, r->origin};
+        nodes[count + 1] = {r, false, r->destination};
+        meta_nodes[count].node = &nodes[count + 1];
+        meta_nodes[count + 1].node = &nodes[count];
+        meta_nodes[count + 1].unlocks.push_back(&meta_nodes[count]);
+        initially_available.push_back(&meta_nodes[count + 1]);
+        count += 2;
     }
-    set<Request*> onboard;
-    for (auto r : v.passengers)
-        onboard.insert(r);
     for (auto & ns : v.order_record)
     {
-        if (onboard.count(ns.r))
-        {
-            nodes.push_back(ns);
-            meta_nodes.push_back({&nodes[nodes.size() - 1], vector<MetaNodeStop*>()});
-            onboard.erase(ns.r);
-        }
+        if (find(v.passengers.begin(), v.passengers.end(), ns.r) != v.passengers.end() &&
+                find_if(nodes.begin() + 2 * rs.size(), nodes.begin() + count,
+                        [&](NodeStop const & n) { return n.r == ns.r; }) == nodes.begin() + count)
+            nodes[count++] = ns;
     }
     if (CTSP == FIX_ONBOARD && rs.size() + v.passengers.size() > 4 && v.passengers.size())
     {
         for (auto i = 0; i < v.passengers.size() - 1; i++)
-            meta_nodes[meta_nodes.size() - 2 - i].unlocks = 
-                    vector<MetaNodeStop*> {&meta_nodes[meta_nodes.size() - 1 - i]};
-        initially_available.insert(&meta_nodes[meta_nodes.size() - v.passengers.size()]);
+            meta_nodes[count - 2 - i].unlocks.assign(1, &meta_nodes[count - 1 - i]);
+        initially_available.push_back(&meta_nodes[count - v.passengers.size()]);
     }
     else
         for (auto i = 0; i < v.passengers.size(); i++)
-            initially_available.insert(&meta_nodes[meta_nodes.size() - 1 - i]);
+            initially_available.push_back(&meta_nodes[count - 1 - i]);
     
     // Consider recomputing the initially available set to save time, if threshold is exceeded.
-    if (CTSP == FIX_PREFIX && meta_nodes.size() > LP_LIMITVALUE)
+    if (CTSP == FIX_PREFIX && count > LP_LIMITVALUE)
     {
         // First let's determine which requests are not available in the previous ordering.
-        set<Request*> previous_requests (v.pending_requests.begin(), v.pending_requests.end());
-        set<Request*> new_requests;
+        int new_requests = 0;
         for (auto r : rs)
-            if (!previous_requests.count(r))
-                new_requests.insert(r);
+            if (find(v.pending_requests.begin(), v.pending_requests.end(), r) == v.pending_requests.end())
+                new_requests++;
         
-        if (2 * new_requests.size() > LP_LIMITVALUE)  // There are too many to process.  Reject.
+        if (2 * new_requests > LP_LIMITVALUE)  // There are too many to process.  Reject.
             return make_pair(-1, vector<NodeStop>());
         
         // Now we must run the processing step.  First get an ordered list from last time.
-        map<NodeStop,MetaNodeStop*> node_to_meta;
-        for (auto & m : meta_nodes)
-            node_to_meta[*m.node] = &m;
-        vector<MetaNodeStop*> previous_order;
+        vector<MetaNodeStop*> & previous_order = scratch.previous_order;
+        previous_order.clear();
         for (auto & ns : v.order_record)
-            if (node_to_meta.count(ns))
-                previous_order.push_back(node_to_meta[ns]);
+            for (auto i = 0; i < count; i++)
+                if (meta_nodes[i].node->r == ns.r && meta_nodes[i].node->is_pickup == ns.is_pickup)
+                {
+                    previous_order.push_back(&meta_nodes[i]);
+                    break;
+                }
         
-        if (previous_order.size() < meta_nodes.size() - LP_LIMITVALUE)
+        if (previous_order.size() < count - LP_LIMITVALUE)
             throw runtime_error("The algebra here was done incorrectly!");
         
         // Now initialize the states.
-        set<MetaNodeStop*> captured = initially_available;
-        initially_available = set<MetaNodeStop*> {previous_order[0]};
+        vector<MetaNodeStop*> & captured = scratch.captured;
+        captured = initially_available;
+        initially_available.assign(1, previous_order[0]);
         
         // Now run the algorithm.
-        for (auto i = 0; i < meta_nodes.size() - LP_LIMITVALUE; i++)
+        for (auto i = 0; i < count - LP_LIMITVALUE; i++)
         {
-            captured.erase(previous_order[i]);  // These two steps update what is captured.
-            for (auto m : previous_order[i]->unlocks)
-                captured.insert(m);
-            if (i + 1 < meta_nodes.size() - LP_LIMITVALUE) // These steps decide what is unlocked.
-                previous_order[i]->unlocks = vector<MetaNodeStop*> {previous_order[i + 1]};
+            captured.erase(remove(captured.begin(), captured.end(), previous_order[i]), captured.end());
+            for (auto m : previous_order[i]->unlocks)  // These two steps update what is captured.
+                if (find(captured.begin(), captured.end(), m) == captured.end())
+                    captured.push_back(m);
+            if (i + 1 < count - LP_LIMITVALUE) // These steps decide what is unlocked.
+                previous_order[i]->unlocks.assign(1, previous_order[i + 1]);
             else
-                previous_order[i]->unlocks = vector<MetaNodeStop*>(captured.begin(), captured.end());
+                previous_order[i]->unlocks = captured;
         }
     }
     
     // Call the recursive cost function.
     int call_time = time + v.offset;
     int start_node = v.node;
-    pair<int, vector<NodeStop*>> optimal;
+    int optimal;
     if (CTSP_OBJECTIVE == CTSP_VMT)
-        optimal = recursive_search(start_node, v.capacity - v.passengers.size(),
-                initially_available, network, call_time, -1);
+        optimal = recursive_search(start_node, v.capacity - v.passengers.size(), initially_available, count,
+                network, call_time, bound, deadline);
     else
         throw runtime_error("No valid CTSP objective selected.");
     
-    return format_path(optimal, time);
+    return format_path(optimal, scratch.path, time);
 }
 
 pair<int,vector<NodeStop>> memory(Vehicle const & v, Network const & network, int time)
 {
     // Create meta nodes, with unlocking sequence forcing the order from memory.
-    vector<NodeStop> nodes;
-    vector<MetaNodeStop> meta_nodes;
-    nodes.reserve(v.order_record.size());
-    for (auto & ns : v.order_record)
-    {
-        nodes.push_back(ns);
-        meta_nodes.push_back(MetaNodeStop{&nodes[nodes.size() - 1], vector<MetaNodeStop*>()});
-    }
-    set<MetaNodeStop*> initially_available;
-    if (meta_nodes.size())
-        initially_available.insert(&meta_nodes[0]);
-    for (auto i = 1; i < meta_nodes.size(); i++)
-        meta_nodes[i - 1].unlocks = vector<MetaNodeStop*> {&meta_nodes[i]};
+    int count = v.order_record.size();
+    prepare_stops(count);
+    for (auto i = 0; i < count; i++)
+        scratch.nodes[i] = v.order_record[i];
+    if (count)
+        scratch.available.push_back(&scratch.meta_nodes[0]);
+    for (auto i = 1; i < count; i++)
+        scratch.meta_nodes[i - 1].unlocks.push_back(&scratch.meta_nodes[i]);
     
     // Call the recursive cost function.
     int call_time = time + v.offset;
     int start_node = v.node;
-    pair<int, vector<NodeStop*>> optimal;
+    int optimal;
+    NoDeadline deadline;
     if (CTSP_OBJECTIVE == CTSP_VMT)
-        optimal = recursive_search(start_node, v.capacity - v.passengers.size(),
-            initially_available, network, call_time, -1);
+        optimal = recursive_search(start_node, v.capacity - v.passengers.size(), scratch.available, count,
+                network, call_time, -1, deadline);
     else
         throw runtime_error("No valid CTSP objective selected.");
-    return format_path(optimal, time);
+    return format_path(optimal, scratch.path, time);
 }
 
-// The implementation of Travel() function
-pair<int,vector<NodeStop>> travel(Vehicle const & vehicle, vector<Request*> const & requests,
-        Purpose trigger, Network const & network, int time)
+/* Latest service time at a stop: the alighting deadline, and for pickups the waiting limit too. */
+int get_stop_deadline(NodeStop const & ns)
 {
-    if (trigger == MEMORY)
-        return memory(vehicle, network, time);
-    else if (trigger == REBALANCING)
-        return rebalance(vehicle, requests, network);
-    else
-        return new_travel(vehicle, requests, network, time);
+    int deadline = get_alight_deadline(ns.r);
+    if (ns.is_pickup)
+        deadline = min(deadline, ns.r->entry_time + MAX_WAITING);
+    return deadline;
 }
 
+/* Follows a fixed stop order with the same rules as the search.  Returns the time the last stop is served,
+   or -1 once a time window or the capacity is broken.  If given, service receives the time each stop is
+   served and absorbed how much earlier the vehicle could have arrived at no cost, waiting for a pickup. */
+int schedule(Vehicle const & v, vector<NodeStop> const & order, Network const & network, int time,
+        vector<int>* service = NULL, vector<int>* absorbed = NULL)
+{
+    int location = v.node;
+    int residual_capacity = v.capacity - v.passengers.size();
+    Action prev_action = NO_ACTION;
+    for (auto & ns : order)
+    {
+        int dwell = 0;
+        if (prev_action == DROPOFF && (ns.is_pickup || location != ns.node))
+            dwell = DWELL_ALIGHT;
+        else if (prev_action == PICKUP && (!ns.is_pickup || location != ns.node))
+            dwell = DWELL_PICKUP;
+        int arrival_time = time + network.get_time(location, ns.node, time + dwell);
+        int slack = 0;
+        if (ns.is_pickup && ns.r->entry_time > arrival_time)
+        {
+            slack = ns.r->entry_time - arrival_time;
+            arrival_time = ns.r->entry_time;
+        }
+        time = arrival_time + dwell;
+        
+        residual_capacity += (ns.is_pickup ? -1 : 1);
+        if (residual_capacity < 0 || time > get_stop_deadline(ns))
+            return -1;
+        if (service)
+            service->push_back(time);
+        if (absorbed)
+            absorbed->push_back(slack);
+        location = ns.node;
+        prev_action = (ns.is_pickup ? PICKUP : DROPOFF);
+    }
+    return time;
+}
 
-
-
-
-
-
-
-
-
-
-pair<int,vector<NodeStop*>> recursive_search_timed(int initial_location, int residual_capacity,
-        set<MetaNodeStop*,MnsSort> const & initially_available, Network const & network, int time, int best_time,
-        Action prev_action, chrono::steady_clock::time_point t)
+/* Finishing time of the fastest route inserting r into order, which is left in scratch.best_order, or -1 if
+   there is none. */
+int insert_request(Vehicle const & v, vector<NodeStop> const & order, Request* r, Network const & network,
+        int time)
 {
-    // If there is no new available stop to add...
-    if (!initially_available.size())
-        return make_pair(time, vector<NodeStop*>()); // VMT objective
+    // The order must drop off everyone aboard, which an order from a failed search does not.
+    int dropoffs = 0;
+    for (auto & ns : order)
+        if (!ns.is_pickup && find(v.passengers.begin(), v.passengers.end(), ns.r) != v.passengers.end())
+            dropoffs++;
+    int call_time = time + v.offset;
+    vector<int> & service = scratch.service;
+    vector<int> & absorbed = scratch.absorbed;
+    service.clear();
+    absorbed.clear();
+    if (dropoffs != v.passengers.size() || schedule(v, order, network, call_time, &service, &absorbed) < 0)
+        return -1;
+    int n = order.size();
     
-    // Iterate through the possible next NodeStops to visit.
-    vector<NodeStop*> best_tail;
-    MetaNodeStop* previous = NULL;
-    for (MetaNodeStop* m : initially_available)
+    // Delay each stop can take on arrival, from the last stop back.  A later delay is soaked up by waiting
+    // for a pickup before it reaches that stop's deadline.
+    int const UNBOUNDED = numeric_limits<int>::max() / 2;
+    vector<int> & tolerance = scratch.tolerance;
+    tolerance.assign(n + 1, UNBOUNDED);
+    for (auto k = n; k--;)
+        tolerance[k] = absorbed[k] + min(get_stop_deadline(order[k]) - service[k],
+                (k + 1 < n ? tolerance[k + 1] : UNBOUNDED));
+    
+    // Passengers aboard when leaving each position, so a pickup can be ruled out by capacity early.
+    vector<int> & load = scratch.load;
+    load.assign(n + 1, v.passengers.size());
+    for (auto k = 0; k < n; k++)
+        load[k + 1] = load[k] + (order[k].is_pickup ? 1 : -1);
+    
+    NodeStop pickup {r, true, r->origin};
+    NodeStop dropoff {r, false, r->destination};
+    bool use_tolerance = !network.has_time_profiles();
+    int best_time = -1;
+    vector<NodeStop> & best_order = scratch.best_order;
+    vector<NodeStop> & candidate = scratch.candidate;
+    for (auto i = 0; i <= n; i++)
     {
-        // Check for a timeout...
-        if (RTV_TIMELIMIT)
+        // The pickup detour delays the stop after it by at least the extra travel time.
+        if (use_tolerance && i < n)
         {
-            auto end_time = chrono::steady_clock::now();
-            auto duration = chrono::duration_cast<chrono::milliseconds>
-                    (end_time - t).count();
-            if (duration > RTV_TIMELIMIT)
-                break;
+            int before = (i ? order[i - 1].node : v.node);
+            int detour = network.get_time(before, r->origin) + network.get_time(r->origin, order[i].node) -
+                    network.get_time(before, order[i].node);
+            if (detour > tolerance[i])
+                continue;
         }
-        
-        // Select the node.  Strict order on alightings.
-        if (previous != NULL && !m->node->is_pickup && previous->node->node == m->node->node)
-            continue;
-        previous = m;
-        
-        // Compute time of visit.
-        int new_location = m->node->node;
-        int arrival_time = time + network.get_time(initial_location, new_location);
-        if (m->node->is_pickup)
-            if (m->node->r->entry_time > arrival_time)
-                arrival_time = m->node->r->entry_time;
-        
-        // Account for rule about batched boarding/alighting.  Must match simulator behavior.
-        if (prev_action == DROPOFF && (m->node->is_pickup || initial_location != new_location))
-            arrival_time += DWELL_ALIGHT;
-        else if (prev_action == PICKUP && (!m->node->is_pickup || initial_location != new_location))
-            arrival_time += DWELL_PICKUP;
-        
-        // Skip if this violates the time bound.
-        if (best_time != -1 && arrival_time >= best_time) // Use for VMT objective
-            continue;
-        
-        // Assert this satisfies the capacity constraints.
-        int new_residual_capacity = residual_capacity;
-        if (m->node->is_pickup)
-            new_residual_capacity--;
-        else
-            new_residual_capacity++;
-        if (new_residual_capacity < 0)
-            continue;
-        
-        // Assert this is in the acceptable time range.
-        if (m->node->is_pickup && arrival_time > m->node->r->entry_time + MAX_WAITING)
-            continue;
-        if (get_alight_deadline(m->node->r) < arrival_time)
-            continue;
-        
-        // Create the new availability list, considering unlocked nodes.f
-        set<MetaNodeStop*,MnsSort> remaining_nodes;
-        for (auto x : initially_available)
-            if (x != m)
-                remaining_nodes.insert(x);
-        if (m->unlocks.size())
-            for (auto newnode : m->unlocks)
-                remaining_nodes.insert(newnode);
-        
-        // Basic check: can subsequent nodes be served?
-        bool basic_reachability = true;
-        for (auto x : remaining_nodes)
+        for (auto j = i; j <= n; j++)
         {
-            int reaching_time = arrival_time + network.get_time(new_location, x->node->node);
-            if ((x->node->is_pickup && reaching_time > x->node->r->latest_boarding) ||
-                    (!x->node->is_pickup && reaching_time > x->node->r->latest_alighting))
-            {
-                basic_reachability = false;
+            if (load[j] + 1 > v.capacity)  // The new passenger would ride past stop j - 1 over capacity.
                 break;
+            candidate.assign(order.begin(), order.begin() + i);
+            candidate.push_back(pickup);
+            candidate.insert(candidate.end(), order.begin() + i, order.begin() + j);
+            candidate.push_back(dropoff);
+            candidate.insert(candidate.end(), order.begin() + j, order.end());
+            int finish = schedule(v, candidate, network, call_time);
+            if (finish >= 0 && (best_time == -1 || finish < best_time))
+            {
+                best_time = finish;
+                best_order = candidate;
             }
         }
-        if (!basic_reachability)
-            continue;
-        
-        // Recursive call to get cost, partial reverse path of tail.
-        Action this_action = (m->node->is_pickup ? PICKUP : DROPOFF);
-        pair<int,vector<NodeStop*>> tail = recursive_search_timed(new_location, new_residual_capacity,
-                remaining_nodes, network, arrival_time, best_time, this_action, t);
-        
-        // If this is the best we have seen so far, update!
-        if (tail.first == -1)
-            continue;
-        if (best_time == -1 || tail.first < best_time)
-        {
-            best_time = tail.first;
-            best_tail = tail.second;
-            best_tail.push_back(m->node);
-        }
     }
     
-    return make_pair(best_time, best_tail);
+    return best_time;
 }
 
-pair<int,vector<NodeStop*>> recursive_search_timed(int initial_location, int residual_capacity,
-        set<MetaNodeStop*> const & initially_available, Network const & network, int time, int best_time,
-        chrono::steady_clock::time_point t)
+pair<int,vector<NodeStop>> insertion(Vehicle const & v, vector<NodeStop> const & order, Request* r,
+        Network const & network, int time)
 {
-    set<MetaNodeStop*,MnsSort> update (initially_available.begin(), initially_available.end());
-    return recursive_search_timed(initial_location, residual_capacity, update, network, time, best_time, NO_ACTION, t);
+    int best_time = insert_request(v, order, r, network, time);
+    if (best_time < 0)
+        return make_pair(-1, vector<NodeStop>());
+    if (CTSP_OBJECTIVE == CTSP_VMT)
+        best_time -= time;
+    return make_pair(best_time, scratch.best_order);
 }
 
-pair<int,vector<NodeStop>> new_time_travel(Vehicle const & v, vector<Request*> const & rs,
-        Network const & network, int time, chrono::steady_clock::time_point t)
+bool feasible(Vehicle const & v, vector<Request*> const & rs, Network const & network, int time)
 {
-    // Convert onboard passengers and new ones into NodeStops and MetaNodeStops.
-    vector<NodeStop> nodes;                                 // Wrapper for locations.
-    vector<MetaNodeStop> meta_nodes;                        // Object that store precedence.
-    set<MetaNodeStop*> initially_available;              // Place you can visit without precedence.
-    nodes.reserve(2 * rs.size() + v.passengers.size());
-    meta_nodes.reserve(2 * rs.size() + v.passengers.size());
+    // Orders restricted by CTSP take the full setup of new_travel, stopping at the first route.
+    int stop_count = 2 * rs.size() + v.passengers.size();
+    if ((CTSP == FIX_ONBOARD && rs.size() + v.passengers.size() > 4 && v.passengers.size()) ||
+            (CTSP == FIX_PREFIX && stop_count > LP_LIMITVALUE) || stop_count > KERNEL_STOPS)
+    {
+        FirstRoute first;
+        return new_travel(v, rs, network, time, first).first >= 0;
+    }
     
+    // Otherwise fill the bitmask search directly: pickups then dropoffs of the new requests, then the
+    // dropoffs of the riders, each once, as new_travel finds them in the order record.
+    Request* requests[KERNEL_STOPS];
+    bool pickups[KERNEL_STOPS];
+    int count = 0;
     for (auto r : rs)
     {
-        nodes.push_back({r, true, r->origin});
-        nodes.push_back({r, false, r->destination});
-        meta_nodes.push_back({&nodes[nodes.size() - 1], vector<MetaNodeStop*>()});
-        meta_nodes.push_back({&nodes[nodes.size() - 2], 
-                vector<MetaNodeStop*>{&meta_nodes[meta_nodes.size() - 1]}});
-        initially_available.insert(&meta_nodes[meta_nodes.size() - 1]);
+        requests[count] = requests[count + 1] = r;
+        pickups[count++] = true;
+        pickups[count++] = false;
     }
-    set<Request*> onboard;
-    for (auto r : v.passengers)
-        onboard.insert(r);
     for (auto & ns : v.order_record)
-    {
-        if (onboard.count(ns.r))
+        if (find(v.passengers.begin(), v.passengers.end(), ns.r) != v.passengers.end() &&
+                find(requests + 2 * rs.size(), requests + count, ns.r) == requests + count)
         {
-            nodes.push_back(ns);
-            meta_nodes.push_back({&nodes[nodes.size() - 1], vector<MetaNodeStop*>()});
-            onboard.erase(ns.r);
+            requests[count] = ns.r;
+            pickups[count++] = false;
         }
+    
+    // Sort by node, alightings first, as MnsSort does, so the rule on batched alightings holds.
+    int order[KERNEL_STOPS], position[KERNEL_STOPS];
+    for (auto i = 0; i < count; i++)
+        order[i] = i;
+    auto location = [&](int i) { return (pickups[i] ? requests[i]->origin : requests[i]->destination); };
+    sort(order, order + count, [&](int a, int b) {
+            return (location(a) < location(b) || (location(a) == location(b) && pickups[a] < pickups[b])); });
+    for (auto i = 0; i < count; i++)
+        position[order[i]] = i;
+    
+    KernelState s;
+    s.network = &network;
+    s.best_time = -1;
+    s.bound_finish = !network.has_time_profiles();
+    s.best_length = 0;
+    s.found = 0;
+    uint64_t available = 0;
+    for (auto i = 0; i < count; i++)
+    {
+        int original = order[i];
+        Request const* r = requests[original];
+        KernelStop & k = s.stops[i];
+        k.node = NULL;
+        k.location = location(original);
+        k.is_pickup = pickups[original];
+        k.entry_time = r->entry_time;
+        k.deadline = get_alight_deadline(r);
+        if (k.is_pickup)
+            k.deadline = min(k.deadline, r->entry_time + MAX_WAITING);
+        k.latest_reach = (k.is_pickup ? r->latest_boarding : r->latest_alighting);
+        k.ride_bound = (k.is_pickup ? network.get_lower_bound(k.location, r->destination) : 0);
+        k.unlocks = (k.is_pickup ? uint64_t(1) << position[original + 1] : 0);
+        if (!k.is_pickup && original < 2 * rs.size())
+            continue;  // Unlocked by its pickup.
+        available |= uint64_t(1) << i;
     }
-    if (CTSP == FIX_ONBOARD && rs.size() + v.passengers.size() > 4 && v.passengers.size())
+    
+    FirstRoute first;
+    uint64_t unvisited = (count == KERNEL_STOPS ? ~uint64_t(0) : (uint64_t(1) << count) - 1);
+    rank_deadlines(s, count);
+    kernel_search(s, v.node, v.capacity - v.passengers.size(), available, to_ranks(s, available), unvisited,
+            time + v.offset, NO_ACTION, 0, SAME, first);
+    return s.best_time >= 0;
+}
+
+int const LNS_STOPS = 12;       // Most stops MEGA_TSP still searches exactly.
+int const LNS_REMOVALS = 3;     // Most riders taken out of the route per LNS move.
+
+/* Puts the dropoff ns back into order where the route ends soonest.  Returns that finishing time, or -1 if
+   no position works. */
+int reinsert_dropoff(Vehicle const & v, vector<NodeStop> & order, NodeStop const & ns, Network const & network,
+        int call_time)
+{
+    int best_time = -1;
+    int best_position = 0;
+    order.insert(order.begin(), ns);
+    for (auto j = 0; j < order.size(); j++)
     {
-        for (auto i = 0; i < v.passengers.size() - 1; i++)
-            meta_nodes[meta_nodes.size() - 2 - i].unlocks = 
-                    vector<MetaNodeStop*> {&meta_nodes[meta_nodes.size() - 1 - i]};
-        initially_available.insert(&meta_nodes[meta_nodes.size() - v.passengers.size()]);
+        if (j)
+            swap(order[j - 1], order[j]);
+        int finish = schedule(v, order, network, call_time);
+        if (finish >= 0 && (best_time == -1 || finish < best_time))
+        {
+            best_time = finish;
+            best_position = j;
+        }
     }
+    if (best_time < 0)
+        order.pop_back();
     else
-        for (auto i = 0; i < v.passengers.size(); i++)
-            initially_available.insert(&meta_nodes[meta_nodes.size() - 1 - i]);
+        rotate(order.begin() + best_position, order.end() - 1, order.end());
+    return best_time;
+}
+
+/* Anytime large neighbourhood search for CTSP MEGA_TSP, where exact search is out of reach.  It starts from
+   the vehicle's previous order with the new requests inserted, or from the first route of the exact search
+   if that fails, so it finds a route whenever one exists.  Each move takes a few riders out and puts them
+   back where the route ends soonest, and is kept unless the route ends later.  Runs MEGA_TSP_ITERATIONS
+   moves, or until the deadline, which it asks once a move; time_travel has a ClockDeadline read the clock
+   each time.  Routes follow schedule(), so the rules are those of recursive_search.  Buffers are in scratch. */
+template <typename Deadline>
+pair<int,vector<NodeStop>> lns_travel(Vehicle const & v, vector<Request*> const & rs, Network const & network,
+        int time, Deadline & deadline)
+{
+    int call_time = time + v.offset;
+    int stop_count = 2 * rs.size() + v.passengers.size();
     
-    // Consider recomputing the initially available set to save time, if threshold is exceeded.
-    if (CTSP == FIX_PREFIX && meta_nodes.size() > LP_LIMITVALUE)
+    // The previous order of these stops, each rider's dropoff once.
+    vector<NodeStop> & order = scratch.order;
+    order.clear();
+    for (auto & ns : v.order_record)
     {
-        // First let's determine which requests are not available in the previous ordering.
-        set<Request*> previous_requests (v.pending_requests.begin(), v.pending_requests.end());
-        set<Request*> new_requests;
-        for (auto r : rs)
-            if (!previous_requests.count(r))
-                new_requests.insert(r);
-        
-        if (2 * new_requests.size() > LP_LIMITVALUE)  // There are too many to process.  Reject.
+        bool requested = (find(rs.begin(), rs.end(), ns.r) != rs.end());
+        bool aboard = (!ns.is_pickup && find(v.passengers.begin(), v.passengers.end(), ns.r) != v.passengers.end());
+        if ((requested || aboard) && find_if(order.begin(), order.end(), [&](NodeStop const & other) {
+                return (other.r == ns.r && other.is_pickup == ns.is_pickup); }) == order.end())
+            order.push_back(ns);
+    }
+    for (auto r : rs)
+        if (find_if(order.begin(), order.end(), [&](NodeStop const & ns) { return ns.r == r; }) == order.end())
+        {
+            if (insert_request(v, order, r, network, time) < 0)
+                break;
+            order.swap(scratch.best_order);
+        }
+    int best_time = (order.size() == stop_count ? schedule(v, order, network, call_time) : -1);
+    if (best_time < 0)
+    {
+        FirstRouteWithin<Deadline> first (deadline);
+        auto route = new_travel(v, rs, network, time, first);
+        if (route.first < 0)
+            return route;
+        order.swap(route.second);
+        best_time = schedule(v, order, network, call_time);
+        if (best_time < 0)
             return make_pair(-1, vector<NodeStop>());
+    }
+    
+    // Riders are the requests, then those aboard, whose dropoffs go back first as insertion needs them.  The
+    // generator starts the same each call, so routes can be cached.
+    vector<Request*> & riders = scratch.riders;
+    riders.assign(rs.begin(), rs.end());
+    riders.insert(riders.end(), v.passengers.begin(), v.passengers.end());
+    minstd_rand random;
+    vector<NodeStop> & candidate = scratch.moved;
+    for (auto iteration = 0; iteration < MEGA_TSP_ITERATIONS && !deadline.expired(); iteration++)
+    {
+        // Draw distinct riders, then reinsert in the order drawn.
+        int removals = 1 + random() % min(LNS_REMOVALS, int(riders.size()));
+        for (auto i = 0; i < removals; i++)
+            swap(riders[i], riders[i + random() % (riders.size() - i)]);
+        candidate.clear();
+        for (auto & ns : order)
+            if (find(riders.begin(), riders.begin() + removals, ns.r) == riders.begin() + removals)
+                candidate.push_back(ns);
         
-        // Now we must run the processing step.  First get an ordered list from last time.
-        map<NodeStop,MetaNodeStop*> node_to_meta;
-        for (auto & m : meta_nodes)
-            node_to_meta[*m.node] = &m;
-        vector<MetaNodeStop*> previous_order;
-        for (auto & ns : v.order_record)
-            if (node_to_meta.count(ns))
-                previous_order.push_back(node_to_meta[ns]);
-        
-        if (previous_order.size() < meta_nodes.size() - LP_LIMITVALUE)
-            throw runtime_error("The algebra here was done incorrectly!");
-        
-        // Now initialize the states.
-        set<MetaNodeStop*> captured = initially_available;
-        initially_available = set<MetaNodeStop*> {previous_order[0]};
+        int finish = 0;
+        for (auto i = 0; i < removals && finish >= 0; i++)
+            if (find(rs.begin(), rs.end(), riders[i]) == rs.end())
+                finish = reinsert_dropoff(v, candidate, {riders[i], false, riders[i]->destination}, network,
+                        call_time);
+        for (auto i = 0; i < removals && finish >= 0; i++)
+            if (find(rs.begin(), rs.end(), riders[i]) != rs.end())
+            {
+                finish = insert_request(v, candidate, riders[i], network, time);
+                if (finish >= 0)
+                    candidate.swap(scratch.best_order);
+            }
+        if (finish < 0)
+            continue;
         
-        // Now run the algorithm.
-        for (auto i = 0; i < meta_nodes.size() - LP_LIMITVALUE; i++)
+        finish = schedule(v, candidate, network, call_time);
+        if (finish >= 0 && finish <= best_time)
         {
-            captured.erase(previous_order[i]);  // These two steps update what is captured.
-            for (auto m : previous_order[i]->unlocks)
-                captured.insert(m);
-            if (i + 1 < meta_nodes.size() - LP_LIMITVALUE) // These steps decide what is unlocked.
-                previous_order[i]->unlocks = vector<MetaNodeStop*> {previous_order[i + 1]};
-            else
-                previous_order[i]->unlocks = vector<MetaNodeStop*>(captured.begin(), captured.end());
+            best_time = finish;
+            order.swap(candidate);
         }
     }
     
-    // Call the recursive cost function.
-    int call_time = time + v.offset;
-    int start_node = v.node;
-    pair<int, vector<NodeStop*>> optimal;
     if (CTSP_OBJECTIVE == CTSP_VMT)
-        optimal = recursive_search_timed(start_node, v.capacity - v.passengers.size(),
-                initially_available, network, call_time, -1, t);
-    else
-        throw runtime_error("No valid CTSP objective selected for timed feature.");
+        best_time -= time;
+    return make_pair(best_time, order);
+}
+
+bool uses_lns(Vehicle const & v, vector<Request*> const & rs)
+{
+    return (CTSP == MEGA_TSP && 2 * rs.size() + v.passengers.size() > LNS_STOPS);
+}
+
+/* Route search for the requests, by LNS for large instances under CTSP MEGA_TSP and exactly otherwise. */
+template <typename Deadline>
+pair<int,vector<NodeStop>> search(Vehicle const & v, vector<Request*> const & rs, Network const & network,
+        int time, Deadline & deadline, int bound)
+{
+    if (uses_lns(v, rs))
+        return lns_travel(v, rs, network, time, deadline);
+    return new_travel(v, rs, network, time, deadline, bound);
+}
+
+// The implementation of Travel() function
+pair<int,vector<NodeStop>> solve(Vehicle const & vehicle, vector<Request*> const & requests,
+        Purpose trigger, Network const & network, int time, int bound = -1)
+{
+    if (trigger == MEMORY)
+        return memory(vehicle, network, time);
+    else if (trigger == REBALANCING)
+        return rebalance(vehicle, requests, network);
+    NoDeadline deadline;
+    return search(vehicle, requests, network, time, deadline, bound);
+}
+
+RouteCache route_cache;
+
+/* Everything a route depends on: the vehicle's position, capacity, riders and previous order, the requests
+   and the time.  The low bit of each aligned Request pointer in the order record holds is_pickup. */
+void route_key(Vehicle const & v, vector<Request*> const & requests, Purpose trigger, int time,
+        RouteCache::Key & key)
+{
+    key.assign({uintptr_t(trigger), uintptr_t(time), uintptr_t(v.node), uintptr_t(v.offset),
+            uintptr_t(v.capacity), v.passengers.size(), v.order_record.size(), v.pending_requests.size()});
+    for (auto r : v.passengers)
+        key.push_back(uintptr_t(r));
+    for (auto & ns : v.order_record)
+        key.push_back(uintptr_t(ns.r) | ns.is_pickup);
+    for (auto r : v.pending_requests)
+        key.push_back(uintptr_t(r));
+    for (auto r : requests)
+        key.push_back(uintptr_t(r));
+}
+
+/* Travel with a bound as in new_travel.  Only the searches that come back within an epoch are cached: the
+   vehicle's own route with no new requests, from RTV round 0 and again when the simulator moves a vehicle
+   left without a trip, and the MEMORY route of previoustrip, which the simulator follows.  Each RTV trip is
+   searched once per vehicle, so caching those cost more than it saved.  Failing to beat the bound says
+   nothing of the requests, so only routes found are kept then. */
+pair<int,vector<NodeStop>> bounded_travel(Vehicle const & vehicle, vector<Request*> const & requests,
+        Purpose trigger, Network const & network, int time, int bound)
+{
+    if (!ROUTE_CACHE || trigger == REBALANCING || (trigger == STANDARD && requests.size()))
+        return solve(vehicle, requests, trigger, network, time, bound);
     
-    return format_path(optimal, time);
+    // Requests in id order, so the search breaks ties the same way whichever caller filled the cache.
+    vector<Request*> & sorted = scratch.sorted;
+    sorted = requests;
+    sort(sorted.begin(), sorted.end(), [](Request const* a, Request const* b) {
+            return (a->id < b->id || (a->id == b->id && a < b)); });
+    RouteCache::Key & key = scratch.key;
+    route_key(vehicle, sorted, trigger, time, key);
+    RouteCache::Route route;
+    if (route_cache.find(key, route))
+        return route;
+    route = solve(vehicle, sorted, trigger, network, time, bound);
+    if (route.first >= 0 || bound == -1)
+        route_cache.insert(key, route);
+    return route;
+}
+
+pair<int,vector<NodeStop>> travel(Vehicle const & vehicle, vector<Request*> const & requests,
+        Purpose trigger, Network const & network, int time)
+{
+    return bounded_travel(vehicle, requests, trigger, network, time, -1);
 }
 
+void clear_cache()
+{
+    route_cache.clear();
+}
 
 pair<int,vector<NodeStop>> time_travel(Vehicle const & vehicle, vector<Request*> const & requests,
         Purpose trigger, Network const & network, int time, chrono::steady_clock::time_point t)
@@ -572,7 +1371,42 @@ pair<int,vector<NodeStop>> time_travel(Vehicle const & vehicle, vector<Request*>
         return travel(vehicle, requests, trigger, network, time);
     if (trigger != STANDARD)
         throw runtime_error("Received a trigger type that is not valid for \"routeplanner::time_travel\".");
-    return new_time_travel(vehicle, requests, network, time, t);
+    // A move of the LNS takes far longer than an expansion of the exact search.
+    ClockDeadline deadline (t, (uses_lns(vehicle, requests) ? 1 : DEADLINE_CHECK_INTERVAL));
+    return search(vehicle, requests, network, time, deadline, -1);
+}
+
+/* FIX_ONBOARD and FIX_PREFIX restrict the order, which an incumbent from elsewhere may break. */
+bool takes_incumbent()
+{
+    return (CTSP == FULL || CTSP == FULL_DP || CTSP == MEGA_TSP);
+}
+
+pair<int,vector<NodeStop>> time_travel(Vehicle const & vehicle, vector<Request*> const & requests,
+        Purpose trigger, Network const & network, int time, chrono::steady_clock::time_point t,
+        vector<NodeStop> const & incumbent)
+{
+    // An order of other stops bounds nothing, and neither does one the CTSP restrictions may not allow.
+    int finish = -1;
+    if (trigger == STANDARD && takes_incumbent() && incumbent.size() == 2 * requests.size() + vehicle.passengers.size())
+        finish = schedule(vehicle, incumbent, network, time + vehicle.offset);
+    if (finish < 0)
+        return time_travel(vehicle, requests, trigger, network, time, t);
+    
+    // An exact search only finds routes at least as fast as the incumbent, which is kept if the clock runs out.
+    pair<int,vector<NodeStop>> route;
+    if (!RTV_TIMELIMIT)
+        route = bounded_travel(vehicle, requests, trigger, network, time, finish + 1);
+    else
+    {
+        ClockDeadline deadline (t, (uses_lns(vehicle, requests) ? 1 : DEADLINE_CHECK_INTERVAL));
+        route = search(vehicle, requests, network, time, deadline, finish + 1);
+    }
+    if (CTSP_OBJECTIVE == CTSP_VMT)
+        finish -= time;
+    if (route.first >= 0 && route.first <= finish)  // The LNS may do worse.
+        return route;
+    return make_pair(finish, incumbent);
 }
 
 }
@@ -37,26 +37,44 @@ using namespace std;
 Algorithm ALGORITHM = ILP_FULL;
 double alpha = 0.5;
 AssignmentObjective ASSIGNMENT_OBJECTIVE = AO_SERVICERATE;
+bool BUILD_MATRIX = false;
 int CARSIZE = 4;
 Ctsp CTSP = FIX_PREFIX;
 CtspObjective CTSP_OBJECTIVE = CTSP_VMT;
 string DATAROOT = "data";
+string DISTANCEFILE = "";
 int DWELL_ALIGHT = 0;
 int DWELL_PICKUP = 0;
 string EDGECOST_FILE = "edges.csv";
 int FINAL_TIME = 240000;
 int INITIAL_TIME = 0;       // Time in HHMMSS
+bool INSERTION_HEURISTIC = false;
 int INTERVAL = 60;
+int LANDMARKS = 16;
 bool LAST_MINUTE_SERVICE;
 int MAX_DETOUR = 600;
 int MAX_WAITING = 300;
+int MEGA_TSP_ITERATIONS = 200;
+NetworkBackend NETWORK_BACKEND = NB_MATRIX;
+NodeOrder NODE_ORDER = NO_FILE;
+string NODES_FILE = "nodes.csv";
 string REQUEST_DATA_FILE = "requests.csv";
 string RESULTS_DIRECTORY = "results";
+bool ROUTE_CACHE = false;
 int RH = 0;
 int RTV_TIMELIMIT = 0;
+RvCandidates RV_CANDIDATES = RV_GRID;
+string SHARED_NETWORK = "";
+string SUCCESSORFILE = "successors.bin";
+bool SUCCESSOR_TABLE = false;
 string TIMEFILE = "times.csv";
+int TIME_PROFILE_PERIOD = 3600;
+string TIME_PROFILE_PREFIX = "times_";
+int TIME_PROFILES = 0;
+bool TRANSPOSED_MATRIX = false;
 string VEHICLE_DATA_FILE = "vehicles.csv";
 int VEHICLE_LIMIT = 1000; // 0;
+bool WARM_START = true;
 
 map<string,Algorithm> algorithm_index {
     {"ILP_FULL", ILP_FULL}};
@@ -64,7 +82,8 @@ map<string,Ctsp> ctsp_index {
     {"FULL", FULL},
     {"FIX_ONBOARD", FIX_ONBOARD},
     {"FIX_PREFIX", FIX_PREFIX},
-    {"MEGA_TSP", MEGA_TSP}};
+    {"MEGA_TSP", MEGA_TSP},
+    {"FULL_DP", FULL_DP}};
 map<string,CtspObjective> ctspobjective_index {
     {"CTSP_VMT", CTSP_VMT},
     {"CTSP_TOTALDROPOFFTIME", CTSP_TOTALDROPOFFTIME},
@@ -72,6 +91,17 @@ map<string,CtspObjective> ctspobjective_index {
 map<string,AssignmentObjective> assignmentobjective_index {
     {"AO_SERVICERATE", AO_SERVICERATE},
     {"AO_RMT", AO_RMT}};
+map<string,NetworkBackend> networkbackend_index {
+    {"MATRIX", NB_MATRIX},
+    {"HIERARCHY", NB_HIERARCHY}};
+map<string,NodeOrder> nodeorder_index {
+    {"FILE", NO_FILE},
+    {"HILBERT", NO_HILBERT},
+    {"RCM", NO_RCM}};
+map<string,RvCandidates> rvcandidates_index {
+    {"SCAN", RV_SCAN},
+    {"GRID", RV_GRID},
+    {"REACH", RV_REACH}};
 
 
 string process_string(string & s)
@@ -81,6 +111,17 @@ string process_string(string & s)
     return s;
 }
 
+bool process_bool(string const & key, string const & value)
+{
+    string s = boost::algorithm::to_lower_copy(value);
+    if (s == "true")
+        return true;
+    else if (s == "false")
+        return false;
+    cout << "For " << key << " trying to interpret \"" << value << "\"." << endl;
+    throw runtime_error("Argument could not be converted into a boolean.");
+}
+
 void initialize(int argc, char** argv)
 {
     for (auto i = 2; i + 1 < argc; i += 2)  // Skip first two arguments, program name and num_threads.
@@ -96,14 +137,34 @@ void initialize(int argc, char** argv)
             RH = stoi(value);
         else if (key == "TIMEFILE")
             TIMEFILE = process_string(value);
+        else if (key == "TIME_PROFILES")
+            TIME_PROFILES = stoi(value);
+        else if (key == "ROUTE_CACHE")
+            ROUTE_CACHE = process_bool(key, value);
+        else if (key == "INSERTION_HEURISTIC")
+            INSERTION_HEURISTIC = process_bool(key, value);
+        else if (key == "WARM_START")
+            WARM_START = process_bool(key, value);
+        else if (key == "LANDMARKS")
+            LANDMARKS = stoi(value);
+        else if (key == "TIME_PROFILE_PREFIX")
+            TIME_PROFILE_PREFIX = process_string(value);
+        else if (key == "TIME_PROFILE_PERIOD")
+            TIME_PROFILE_PERIOD = stoi(value);
+        else if (key == "DISTANCEFILE")
+            DISTANCEFILE = process_string(value);
         else if (key == "EDGECOST_FILE")
             EDGECOST_FILE = process_string(value);
+        else if (key == "NODES_FILE")
+            NODES_FILE = process_string(value);
         else if (key == "VEHICLE_LIMIT")
             VEHICLE_LIMIT = stoi(value);
         else if (key == "MAX_WAITING")
             MAX_WAITING = stoi(value);
         else if (key == "MAX_DETOUR")
             MAX_DETOUR = stoi(value);
+        else if (key == "MEGA_TSP_ITERATIONS")
+            MEGA_TSP_ITERATIONS = stoi(value);
         else if (key == "REQUEST_DATA_FILE")
             REQUEST_DATA_FILE = process_string(value);
         else if (key == "VEHICLE_DATA_FILE")
@@ -136,19 +197,33 @@ void initialize(int argc, char** argv)
                 ASSIGNMENT_OBJECTIVE = assignmentobjective_index[value];
             else
                 throw runtime_error("Could not find Assignment Objective in index in settings.cpp: " + value);
-        else if (key == "LAST_MINUTE_SERVICE")
-        {
-            string s = boost::algorithm::to_lower_copy(value);
-            if (s == "true")
-                LAST_MINUTE_SERVICE = true;
-            else if (s == "false")
-                LAST_MINUTE_SERVICE = false;
+        else if (key == "NETWORK_BACKEND")
+            if (networkbackend_index.count(value))
+                NETWORK_BACKEND = networkbackend_index[value];
             else
-            {
-                cout << "For " << key << " trying to interpret \"" << value << "\"." << endl;
-                throw runtime_error("Argument could not be converted into a boolean.");
-            }
-        }
+                throw runtime_error("Could not find network backend in index in settings.cpp: " + value);
+        else if (key == "NODE_ORDER")
+            if (nodeorder_index.count(value))
+                NODE_ORDER = nodeorder_index[value];
+            else
+                throw runtime_error("Could not find node order in index in settings.cpp: " + value);
+        else if (key == "RV_CANDIDATES")
+            if (rvcandidates_index.count(value))
+                RV_CANDIDATES = rvcandidates_index[value];
+            else
+                throw runtime_error("Could not find RV candidates in index in settings.cpp: " + value);
+        else if (key == "LAST_MINUTE_SERVICE")
+            LAST_MINUTE_SERVICE = process_bool(key, value);
+        else if (key == "BUILD_MATRIX")
+            BUILD_MATRIX = process_bool(key, value);
+        else if (key == "SHARED_NETWORK")
+            SHARED_NETWORK = (value.size() && value[0] != '/' ? "/" + value : value);
+        else if (key == "SUCCESSORFILE")
+            SUCCESSORFILE = process_string(value);
+        else if (key == "SUCCESSOR_TABLE")
+            SUCCESSOR_TABLE = process_bool(key, value);
+        else if (key == "TRANSPOSED_MATRIX")
+            TRANSPOSED_MATRIX = process_bool(key, value);
         else if (key == "INTERVAL")
             INTERVAL = stoi(value);
         else if (key == "RTV_TIMELIMIT")
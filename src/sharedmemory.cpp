@@ -0,0 +1,183 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "formatting.hpp"
+#include "sharedmemory.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+char const SEGMENT_MAGIC[8] = {'R', 'H', 'S', 'H', 'A', 'R', 'E', 'D'};
+uint32_t const SEGMENT_VERSION = 1;
+int const MAX_BLOCKS = 8;
+int const MAX_SIGNATURE = 1024;
+uint64_t const HUGE_PAGE = 2 << 20;
+
+struct SegmentHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t ready;             // Set last by the publisher, read with acquire semantics.
+    int64_t publisher;          // Process id, to notice a publisher that died half way.
+    uint64_t size;
+    int32_t block_count;
+    SharedBlock blocks[MAX_BLOCKS];
+    char signature[MAX_SIGNATURE];
+};
+
+uint64_t align(uint64_t value)
+{
+    return (value + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+}
+
+void* map_segment(int fd, size_t size, int protection)
+{
+    void* region = mmap(NULL, size, protection, MAP_SHARED, fd, 0);
+    if (region == MAP_FAILED)
+        return NULL;
+#ifdef MADV_HUGEPAGE
+    madvise(region, size, MADV_HUGEPAGE);  // Only a hint; needs shmem huge pages enabled in the kernel.
+#endif
+    return region;
+}
+}
+
+SharedSegment::SharedSegment() : region(NULL), size(0) {}
+
+SharedSegment::~SharedSegment()
+{
+    if (region != NULL)
+        munmap(region, size);
+}
+
+bool SharedSegment::attach(string const & name, string const & signature)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    
+    // The publisher sizes the segment right after creating it, then fills it.
+    struct stat st;
+    for (auto tries = 0; fstat(fd, &st) == 0 && size_t(st.st_size) < sizeof(SegmentHeader); tries++)
+    {
+        if (tries == 1000)
+        {
+            close(fd);
+            throw runtime_error("Shared network " + name + " was never sized.  Remove /dev/shm" + name + ".");
+        }
+        usleep(10000);
+    }
+    SegmentHeader const* header = (SegmentHeader const*) map_segment(fd, st.st_size, PROT_READ);
+    close(fd);
+    if (header == NULL)
+        throw runtime_error("Unable to map shared network " + name);
+    region = (void*) header;
+    size = st.st_size;
+    
+    bool waited = false;
+    while (!__atomic_load_n(&header->ready, __ATOMIC_ACQUIRE))
+    {
+        pid_t publisher = header->publisher;
+        if (publisher && kill(publisher, 0) != 0 && errno == ESRCH)
+            throw runtime_error("The process publishing " + name + " exited early.  Remove /dev/shm" + name + ".");
+        if (!waited)
+            info("Waiting for process " + to_string(header->publisher) + " to publish " + name + "...", White);
+        waited = true;
+        usleep(100000);
+    }
+    if (memcmp(header->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) || header->version != SEGMENT_VERSION)
+        throw runtime_error("Shared memory " + name + " does not hold a network.");
+    if (signature != string(header->signature, strnlen(header->signature, MAX_SIGNATURE)))
+        throw runtime_error("Shared network " + name + " was built from other inputs.  Remove /dev/shm" + name +
+                " or choose another SHARED_NETWORK name.");
+    return true;
+}
+
+bool SharedSegment::create(string const & name, string const & signature, vector<SharedBlock> blocks)
+{
+    if (blocks.size() > MAX_BLOCKS || signature.size() >= MAX_SIGNATURE)
+        throw runtime_error("Shared network layout does not fit its header.");
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+    {
+        if (errno == EEXIST)
+            return false;
+        throw runtime_error("Unable to create shared network " + name + ": " + strerror(errno));
+    }
+    
+    uint64_t offset = align(sizeof(SegmentHeader));
+    for (auto & b : blocks)
+    {
+        b.offset = offset;
+        offset = align(offset + b.bytes);
+    }
+    size = offset;
+    if (ftruncate(fd, size) != 0 || (region = map_segment(fd, size, PROT_READ | PROT_WRITE)) == NULL)
+    {
+        close(fd);
+        shm_unlink(name.c_str());
+        throw runtime_error("Unable to size shared network " + name + ": " + strerror(errno));
+    }
+    close(fd);
+    
+    SegmentHeader* header = (SegmentHeader*) region;
+    memcpy(header->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+    header->version = SEGMENT_VERSION;
+    header->publisher = getpid();
+    header->size = size;
+    header->block_count = blocks.size();
+    for (auto i = 0; i < blocks.size(); i++)
+        header->blocks[i] = blocks[i];
+    strncpy(header->signature, signature.c_str(), MAX_SIGNATURE);
+    return true;
+}
+
+void SharedSegment::publish()
+{
+    SegmentHeader* header = (SegmentHeader*) region;
+    __atomic_store_n(&header->ready, 1, __ATOMIC_RELEASE);
+}
+
+SharedBlock SharedSegment::get_block(int index) const
+{
+    SegmentHeader const* header = (SegmentHeader const*) region;
+    if (index < 0 || index >= header->block_count)
+        throw runtime_error("Shared network has no block " + to_string(index) + ".");
+    return header->blocks[index];
+}
+
+void* SharedSegment::get_data(int index) const
+{
+    return (char*) region + get_block(index).offset;
+}
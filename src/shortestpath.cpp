@@ -0,0 +1,176 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "shortestpath.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace shortestpath
+{
+
+struct dijkstra_thread_data
+{
+    vector<vector<neighbor>> const* graph;
+    Matrix<time_cell_t>* times;
+    vector<int>* overflows;
+};
+
+void dijkstra_dispatch(void* dijkstra_data)
+{
+    struct thread_data* t = (struct thread_data*) dijkstra_data;
+    int start = t->start;
+    int end = t->end;
+    
+    struct dijkstra_thread_data* data = (struct dijkstra_thread_data*) t->data;
+    auto & graph = *data->graph;
+    auto & times = *data->times;
+    
+    int node_count = graph.size();
+    weight_t const infinity = numeric_limits<weight_t>::infinity();
+    time_cell_t const max_time = numeric_limits<time_cell_t>::max();
+    vector<weight_t> distance(node_count);
+    typedef pair<weight_t,int> entry;
+    
+    for (int source = start; source < end; source++)
+    {
+        fill(distance.begin(), distance.end(), infinity);
+        distance[source] = 0;
+        priority_queue<entry, vector<entry>, greater<entry>> queue;
+        queue.push(entry(0, source));
+        while (queue.size())
+        {
+            entry top = queue.top();
+            queue.pop();
+            int here = top.second;
+            if (top.first > distance[here])
+                continue;
+            for (auto & n : graph[here])
+                if (distance[here] + n.weight < distance[n.target])
+                {
+                    distance[n.target] = distance[here] + n.weight;
+                    queue.push(entry(distance[n.target], n.target));
+                }
+        }
+        
+        // The largest cell value stands for no path, so a path as long as that does not fit.
+        int overflows = 0;
+        for (int node = 0; node < node_count; node++)
+        {
+            if (distance[node] < max_time)
+                times.set(source, node, time_cell_t(distance[node]));
+            else if (distance[node] < infinity)
+                overflows++;
+        }
+        (*data->overflows)[source] = overflows;
+    }
+}
+
+void build_times(vector<vector<neighbor>> const & adjacency_list, Matrix<time_cell_t> & times,
+        Threads & threads)
+{
+    int node_count = adjacency_list.size();
+    time_cell_t const max_time = numeric_limits<time_cell_t>::max();
+    times.allocate(node_count, node_count, max_time);
+    
+    vector<int> overflows(node_count, 0);
+    struct dijkstra_thread_data data {&adjacency_list, &times, &overflows};
+    threads.auto_thread(node_count, dijkstra_dispatch, (void*) &data);
+    int64_t total = accumulate(overflows.begin(), overflows.end(), int64_t(0));
+    if (total)
+        throw runtime_error(to_string(total) + " paths over the edges take " + to_string(max_time) +
+                " s or longer and do not fit the matrix cell type.  Use a wider cell type (see network.hpp).");
+}
+
+struct successor_thread_data
+{
+    vector<vector<neighbor>> const* graph;
+    Matrix<time_cell_t> const* times;
+    Matrix<node_cell_t>* successors;
+};
+
+void successor_dispatch(void* successor_data)
+{
+    struct thread_data* t = (struct thread_data*) successor_data;
+    struct successor_thread_data* data = (struct successor_thread_data*) t->data;
+    auto & graph = *data->graph;
+    auto & times = *data->times;
+    auto & successors = *data->successors;
+    
+    // The step Network::dijkstra takes: straight to the destination if an edge leads there, else the edge of
+    // positive weight w to v with the least w + times(v, destination), if at most times(here, destination).
+    // Each step strictly lowers the time left, so walks never loop.
+    for (int destination = t->start; destination < t->end; destination++)
+    {
+        successors.set(destination, destination, destination);
+        for (int here = 0; here < graph.size(); here++)
+        {
+            if (here == destination)
+                continue;
+            int best = times.get(here, destination) + 1;
+            int next = -1;
+            for (auto & n : graph[here])
+            {
+                if (n.target == destination)
+                {
+                    next = n.target;
+                    break;
+                }
+                int time = n.weight;  // Whole seconds, as in Network::dijkstra.
+                int follow_up = times.get(n.target, destination);
+                if (time > 0 && time + follow_up < best)
+                {
+                    best = time + follow_up;
+                    next = n.target;
+                }
+            }
+            if (next != -1)
+                successors.set(destination, here, next);
+        }
+    }
+}
+
+void build_successors(vector<vector<neighbor>> const & adjacency_list, Matrix<time_cell_t> const & times,
+        Matrix<node_cell_t> & successors, Threads & threads)
+{
+    int node_count = adjacency_list.size();
+    node_cell_t const none = numeric_limits<node_cell_t>::max();
+    if (node_count >= none)
+        throw runtime_error("Too many nodes for the successor table cell type in network.hpp.");
+    if (times.get_rows() != node_count || times.get_cols() != node_count)
+        throw runtime_error("The successor table needs a travel time matrix covering every node.");
+    
+    successors.allocate(node_count, node_count, none);
+    struct successor_thread_data data {&adjacency_list, &times, &successors};
+    threads.auto_thread(node_count, successor_dispatch, (void*) &data);
+}
+
+}
@@ -52,7 +52,7 @@ void move_jobless_vehicle(Vehicle & v, Network const & network, int time)
     if (v.offset <= INTERVAL)
     {
         actions << v.id << "," << encode_time(time + v.offset)
-                << "," << destination << "," << endl;
+                << "," << network.to_external(destination) << "," << endl;
         int distance = network.get_distance(origin, destination);
         v.add_distance(distance);
         v.prev_node = destination;
@@ -136,7 +136,7 @@ void move_vehicle(Vehicle & vehicle, Trip const & trip, Network const & network,
         vehicle.offset = 0;
         vehicle.prev_node = vehicle.node;
         actions << vehicle.id << "," << encode_time(current_time) <<
-                        "," << vehicle.node << "," << endl;
+                        "," << network.to_external(vehicle.node) << "," << endl;
     }
     else
     {
@@ -187,7 +187,7 @@ void move_vehicle(Vehicle & vehicle, Trip const & trip, Network const & network,
         }
         
         // Actual nodes to visit as intermediaries.  Starts with origin node.
-        vector<int> waypoints = network.dijkstra(vehicle.node, target_node);
+        vector<int> waypoints = network.get_path(vehicle.node, target_node);
         if (waypoints.size() == 1) // This always results in zero time travel! TODO : Remove this
         {
             int node = waypoints[0];
@@ -200,7 +200,7 @@ void move_vehicle(Vehicle & vehicle, Trip const & trip, Network const & network,
             int origin = waypoints[w - 1];
             int destination = waypoints[w];
             
-            int traveltime = network.get_time(origin, destination);
+            int traveltime = network.get_time(origin, destination, current_time);
             vehicle.prev_node = origin;
             vehicle.node = destination;
             
@@ -221,7 +221,7 @@ void move_vehicle(Vehicle & vehicle, Trip const & trip, Network const & network,
                 vehicle.prev_node = destination; // Since we got there!  Now they match.
                 actions << vehicle.id << "," << 
                         encode_time(current_time) <<
-                        "," << destination << "," << endl;
+                        "," << network.to_external(destination) << "," << endl;
             }
         }
         
@@ -241,7 +241,7 @@ void move_vehicle(Vehicle & vehicle, Trip const & trip, Network const & network,
             int waiting_time = r->entry_time - current_time;
             if (waiting_time >= traveltime_left)
             {
-                vehicle.prev_node = -30;
+                vehicle.prev_node = PREV_WAITING;
                 interrupted = true;
                 vehicle.offset = waiting_time - traveltime_left;
                 break;
@@ -254,7 +254,7 @@ void move_vehicle(Vehicle & vehicle, Trip const & trip, Network const & network,
         }
  
         actions << vehicle.id << "," << encode_time(current_time) <<
-                "," << target_node << ",W" << endl;
+                "," << network.to_external(target_node) << ",W" << endl;
 
         
         if (traveltime_left <= 0)
@@ -274,7 +274,7 @@ void move_vehicle(Vehicle & vehicle, Trip const & trip, Network const & network,
         else
             code = 'A';
         actions << vehicle.id << "," << encode_time(current_time) <<
-                "," << target_node << "," << code << "R" << r->id << endl;
+                "," << network.to_external(target_node) << "," << code << "R" << r->id << endl;
         
         // If this is end of rebalancing.
         if (rebalancing && target_node == newRequests[0]->origin)
@@ -306,17 +306,23 @@ void move_vehicle(Vehicle & vehicle, Trip const & trip, Network const & network,
         } 
         
         // This is the new batched dwell logic.  Must match routeplanner's expectations.
-        int node;
+        int node = target_node;
+        int dwell;
         if (!is_pickup && (x + 1 == path.size() || path[x + 1].is_pickup || path[x + 1].node != target_node))
-            node = -20; // DWELL_ALIGHT
+        {
+            node = PREV_ALIGHT_DWELL;
+            dwell = network.get_dwell_time(false);
+        }
         else if (is_pickup && (!path[x + 1].is_pickup || path[x + 1].node != target_node))
-            node = -10; // DWELL_PICKUP.
+        {
+            node = PREV_PICKUP_DWELL;
+            dwell = network.get_dwell_time(true);
+        }
         else
-            node = target_node;
-        int dwell = network.get_time(node, vehicle.node);
+            dwell = network.get_time(target_node, vehicle.node);
         if (dwell >= traveltime_left)
         {
-            vehicle.prev_node = node;  // Note this is a dummy node -20 or -10, not real.
+            vehicle.prev_node = node;  // Note this is a dummy node, not real.
             interrupted = true;
             vehicle.offset = dwell - traveltime_left;
             break;
@@ -327,7 +333,7 @@ void move_vehicle(Vehicle & vehicle, Trip const & trip, Network const & network,
             current_time += dwell;
         }
         actions << vehicle.id << "," << encode_time(current_time) <<
-                "," << target_node << ",D" << endl;
+                "," << network.to_external(target_node) << ",D" << endl;
     } // End visiting nodes section.
     
     // Transfer the final passenger list.
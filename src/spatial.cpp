@@ -0,0 +1,99 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "spatial.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+VehicleGrid::VehicleGrid(Network const & network, vector<Vehicle*> const & vehicles)
+        : network(network), cell_size(1), min_x(0), min_y(0), cols(1), rows(1)
+{
+    locations.reserve(vehicles.size());
+    for (auto v : vehicles)
+        locations.push_back(network.get_position(v->node));
+    
+    // Size the cells for about two vehicles each over the area the fleet spans.
+    double max_x = 0, max_y = 0;
+    if (locations.size())
+    {
+        min_x = max_x = locations[0].x;
+        min_y = max_y = locations[0].y;
+    }
+    for (auto & p : locations)
+    {
+        min_x = min(min_x, p.x);
+        max_x = max(max_x, p.x);
+        min_y = min(min_y, p.y);
+        max_y = max(max_y, p.y);
+    }
+    double area = max(max_x - min_x, 1.0) * max(max_y - min_y, 1.0);
+    cell_size = max(sqrt(2 * area / max<size_t>(locations.size(), 1)), 1.0);
+    cols = int((max_x - min_x) / cell_size) + 1;
+    rows = int((max_y - min_y) / cell_size) + 1;
+    
+    // Counting sort into cells, which keeps vehicle indices ascending within each cell.
+    vector<int> cells(locations.size());
+    cell_start.assign(cols * rows + 1, 0);
+    for (auto i = 0; i < locations.size(); i++)
+    {
+        cells[i] = cell_of(locations[i].y, min_y, rows) * cols + cell_of(locations[i].x, min_x, cols);
+        cell_start[cells[i] + 1]++;
+    }
+    for (auto c = 0; c < cols * rows; c++)
+        cell_start[c + 1] += cell_start[c];
+    members.resize(locations.size());
+    vector<int> fill (cell_start.begin(), cell_start.end() - 1);
+    for (auto i = 0; i < locations.size(); i++)
+        members[fill[cells[i]]++] = i;
+}
+
+int VehicleGrid::cell_of(double value, double low, int cells) const
+{
+    return min(max(int(floor((value - low) / cell_size)), 0), cells - 1);
+}
+
+void VehicleGrid::query(int node, int seconds, vector<int> & out) const
+{
+    double radius = network.get_reach(seconds);
+    if (radius < 0)
+        return;
+    radius += 1;  // Slack for rounding in the projected lengths.
+    Point center = network.get_position(node);
+    
+    int first_col = cell_of(center.x - radius, min_x, cols), last_col = cell_of(center.x + radius, min_x, cols);
+    int first_row = cell_of(center.y - radius, min_y, rows), last_row = cell_of(center.y + radius, min_y, rows);
+    auto first = out.size();
+    for (auto row = first_row; row <= last_row; row++)
+        for (auto c = row * cols + first_col; c <= row * cols + last_col; c++)
+            for (auto m = cell_start[c]; m < cell_start[c + 1]; m++)
+            {
+                Point p = locations[members[m]];
+                if (hypot(p.x - center.x, p.y - center.y) <= radius)
+                    out.push_back(members[m]);
+            }
+    sort(out.begin() + first, out.end());
+}
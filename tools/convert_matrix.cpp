@@ -0,0 +1,76 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2020 Matthew Zalesak.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Converts a comma separated travel time matrix (such as times.csv) into the binary matrix format that
+   Network memory-maps at start up.  Usage:
+        ./convert_matrix data/map/times.csv data/map/times.bin [cell bytes]
+   Cell bytes is 2 (default, uint16_t) or 4 (int32_t) and should match time_cell_t in network.hpp, or the
+   simulator has to convert the file on load.  Then run the simulator with TIMEFILE times.bin. */
+
+#include "matrix.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    int cell_bytes = (argc == 4 ? atoi(argv[3]) : 2);
+    if ((argc != 3 && argc != 4) || (cell_bytes != 2 && cell_bytes != 4))
+    {
+        cout << "Usage: " << argv[0] << " <input matrix> <output binary matrix> [cell bytes, 2 or 4]" << endl;
+        return 1;
+    }
+    
+    try
+    {
+        int rows, cols;
+        if (cell_bytes == 2)
+        {
+            Matrix<uint16_t> matrix;
+            matrix.load(argv[1]);
+            matrix.save(argv[2]);
+            rows = matrix.get_rows();
+            cols = matrix.get_cols();
+        }
+        else
+        {
+            Matrix<int32_t> matrix;
+            matrix.load(argv[1]);
+            matrix.save(argv[2]);
+            rows = matrix.get_rows();
+            cols = matrix.get_cols();
+        }
+        cout << "Wrote " << rows << " x " << cols << " matrix with " << cell_bytes << " byte cells to "
+                << argv[2] << endl;
+    }
+    catch (exception const & e)
+    {
+        cout << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}